@@ -0,0 +1,23 @@
+#include <ast.h>
+using namespace std;
+
+namespace rs {
+	syntax_tree::syntax_tree() {
+		root = node(ast_node_type::nt_root);
+	}
+
+	syntax_tree::~syntax_tree() {
+		for (ast_node* n : m_nodes) delete n;
+		m_nodes.clear();
+	}
+
+	ast_node* syntax_tree::node(ast_node_type type, const tokenizer::token& tok) {
+		ast_node* n = new ast_node;
+		n->type = type;
+		n->tok = tok;
+		n->op = rs_instruction::null_instruction;
+		n->value = 0;
+		m_nodes.push_back(n);
+		return n;
+	}
+};
\ No newline at end of file
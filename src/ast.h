@@ -0,0 +1,117 @@
+#pragma once
+#include <defs.h>
+#include <parse_utils.h>
+#include <vector>
+
+namespace rs {
+	enum ast_node_type {
+		// children: statements
+		nt_root = 0,
+		// statements in braces. open and close are the braces
+		nt_block,
+		// a single statement in place of a block. children: the statement, or
+		// nothing for statements that compile to nothing. close: where it ends
+		nt_body,
+		// tok: 'return'. children: expression, or nothing
+		nt_return,
+		// tok: 'if'. children: condition, body, and the else body if there is one
+		nt_if,
+		// tok: 'while'. children: condition, body
+		nt_while,
+		// tok: 'for', open: '('. children: initializer, condition, increment and
+		// body. the first three can be null
+		nt_for,
+		// tok: variable name. children: initializer expression, or nothing
+		nt_const,
+		nt_let,
+		// tok: class name, open: 'class'. children: nt_function for methods,
+		// nt_constructor and nt_static
+		nt_class,
+		// tok: 'constructor'. children: the function
+		nt_constructor,
+		// tok: name, open: '=' if initialized. children: initializer expression,
+		// the function for static methods, or nothing
+		nt_static,
+		// tok: name (if any), open: where the function starts, close: '}'.
+		// children: nt_identifier for each parameter, then the body nt_block
+		nt_function,
+
+		// children: the first operand, then an nt_operator for each operator that
+		// follows it. they're evaluated from left to right. close: where the
+		// expression ends when it has no operators
+		nt_expression,
+		// tok: the operator, op: its instruction. children: right side, if it has
+		// one. close: where its right side ends
+		nt_operator,
+		// operators that were evaluated at compile time. replaces the operators
+		// in a row that it's the result of, and the expression's first operand
+		// when that's where they started. tok and close are those of the last one
+		nt_folded,
+		// children: a value and the accessors that follow it
+		nt_access,
+		// open: '.', tok: property name, close: '=' when the property is assigned
+		nt_member,
+		// open: '[', close: ']', tok: '=' when the property is assigned.
+		// children: the index expression
+		nt_index,
+		// open: '(', close: ')'. children: argument expressions, with tok set to
+		// the ',' that follows them
+		nt_call,
+		// open: '(', close: ')'. children: expression
+		nt_parenthesis,
+		// tok: 'new'. children: the value being constructed
+		nt_new,
+		nt_identifier,
+		nt_number,
+		// tok: the string, without quotes
+		nt_string,
+		// open: '{', close: '}'. children: nt_property for each property
+		nt_object,
+		// tok: name, open: ':'. children: value expression
+		nt_property
+	};
+
+	// whether an operator assigns to its left side
+	inline bool is_assignment(rs_instruction op) {
+		switch (op) {
+			case rs_instruction::store:
+			case rs_instruction::addEq:
+			case rs_instruction::subEq:
+			case rs_instruction::mulEq:
+			case rs_instruction::divEq:
+			case rs_instruction::modEq:
+			case rs_instruction::powEq:
+			case rs_instruction::orEq:
+			case rs_instruction::andEq:
+			case rs_instruction::inc:
+			case rs_instruction::dec: return true;
+			default: return false;
+		}
+	}
+
+	struct ast_node {
+		ast_node_type type;
+		tokenizer::token tok;
+		tokenizer::token open;
+		tokenizer::token close;
+		rs_instruction op;
+		// for values, the number that they're known to load after the passes ran.
+		// for nt_folded, the result
+		variable_id value;
+		std::vector<ast_node*> children;
+	};
+
+	// owns the nodes that are parsed from a piece of code
+	class syntax_tree {
+		public:
+			syntax_tree();
+			~syntax_tree();
+
+			ast_node* node(ast_node_type type, const tokenizer::token& tok = tokenizer::token());
+
+			ast_node* root;
+
+		protected:
+			std::vector<ast_node*> m_nodes;
+	};
+};
\ No newline at end of file
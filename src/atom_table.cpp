@@ -0,0 +1,38 @@
+#include <atom_table.h>
+#include <context.h>
+using namespace std;
+
+namespace rs {
+	atom_table::atom_table(const context_parameters& params) {
+		m_ctx = params.ctx;
+		m_strings.push_back("");
+		m_variables.push_back(0);
+	}
+
+	atom_table::~atom_table() {
+		m_ids.clear();
+		m_strings.clear();
+		m_variables.clear();
+	}
+
+	atom_id atom_table::get(const string& str) {
+		auto it = m_ids.find(str);
+		if (it != m_ids.end()) return it->second;
+
+		atom_id atom = atom_id(m_strings.size());
+		m_ids[str] = atom;
+		m_strings.push_back(str);
+		m_variables.push_back(0);
+		return atom;
+	}
+
+	variable_id atom_table::variable(atom_id atom) {
+		if (m_variables[atom]) return m_variables[atom];
+
+		const string& s = m_strings[atom];
+		char* data = new char[s.length()];
+		memcpy(data, s.c_str(), s.length());
+		m_variables[atom] = m_ctx->memory->set_static(rs_builtin_type::t_string, s.length(), data);
+		return m_variables[atom];
+	}
+};
\ No newline at end of file
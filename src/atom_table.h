@@ -0,0 +1,41 @@
+#pragma once
+#include <defs.h>
+#include <string>
+#include <vector>
+
+namespace rs {
+	class context;
+
+	// interned property names and string constants. each distinct string is
+	// given a 32 bit id once, so they can be compared and hashed as integers.
+	// atom 0 is never given to a string
+	class atom_table {
+		public:
+			atom_table(const context_parameters& params);
+			~atom_table();
+
+			// returns the atom for 'str', adding it if it doesn't exist
+			atom_id get(const std::string& str);
+
+			// returns the atom for 'str', or 0 if it was never added
+			inline atom_id find(const std::string& str) const {
+				auto it = m_ids.find(str);
+				if (it == m_ids.end()) return 0;
+				return it->second;
+			}
+
+			inline const std::string& str(atom_id atom) const { return m_strings[atom]; }
+
+			// returns the static string variable for 'atom', shared by every
+			// constant with the same text
+			variable_id variable(atom_id atom);
+
+			inline size_t count() const { return m_strings.size() - 1; }
+
+		protected:
+			context* m_ctx;
+			munordered_map<std::string, atom_id> m_ids;
+			std::vector<std::string> m_strings;
+			std::vector<variable_id> m_variables;
+	};
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <compiler.h>
 #include <context.h>
 #include <parse_utils.h>
+#include <parser.h>
 #include <script_object.h>
 #include <script_function.h>
 #include <prototype.h>
@@ -10,38 +11,19 @@ namespace rs {
 	using instruction = instruction_array::instruction;
 	using token = tokenizer::token;
 
-	variable_id define_static_number(context* ctx, const token& tok, const script_compiler::parse_context& pctx, const tokenizer& t) {
+	variable_id define_static_number(context* ctx, const token& tok) {
 		variable_id vid = 0;
 
+		// the parser already checked that the number fits
 		if (tok.text.find_first_of(".") != string::npos) {
-			double num = atof(tok.text.c_str());
-			decimal_type v = num;
-			if (num < rs_decimal_min || num > rs_decimal_max) {
-				throw parse_exception(
-					format("Number '%s' is too large for internal data type", tok.text.c_str()),
-					pctx.file,
-					t.lines[tok.line],
-					tok.line,
-					tok.col
-				);
-			}
+			decimal_type v = atof(tok.text.c_str());
 			vid = ctx->memory->set_static(
 				rs_builtin_type::t_decimal,
 				sizeof(decimal_type),
 				&v
 			);
 		} else {
-			auto num = atoll(tok.text.c_str());
-			integer_type v = num;
-			if (num < rs_integer_min || num > rs_integer_max) {
-				throw parse_exception(
-					format("Number '%s' is too large for internal data type", tok.text.c_str()),
-					pctx.file,
-					t.lines[tok.line],
-					tok.line,
-					tok.col
-				);
-			}
+			integer_type v = atoll(tok.text.c_str());
 			vid = ctx->memory->set_static(
 				rs_builtin_type::t_integer,
 				sizeof(integer_type),
@@ -52,25 +34,35 @@ namespace rs {
 		return vid;
 	}
 
+	// constants with the same text share one variable
 	variable_id define_static_string(context* ctx, const string& t) {
-		char* str = new char[t.length()];
-		memcpy(str, t.c_str(), t.length());
-		return ctx->memory->set_static(
-			rs_builtin_type::t_string,
-			t.length(),
-			(void*)str
-		);
+		return ctx->atoms->variable(ctx->atoms->get(t));
 	}
 
 
 
 	script_compiler::script_compiler(const context_parameters& params) {
 		m_script_context = params.ctx;
+		m_true = 0;
+		m_false = 0;
+		if (params.compiler.optimize) {
+			m_passes.add(new unreachable_code_pass(m_script_context));
+			m_passes.add(new constant_folding_pass(m_script_context));
+		}
 	}
 
 	script_compiler::~script_compiler() {
 	}
 
+	variable_id script_compiler::static_bool(bool value) {
+		variable_id& id = value ? m_true : m_false;
+		if (!id) {
+			u8 v = value ? 1 : 0;
+			id = m_script_context->memory->set_static(rs_builtin_type::t_bool, sizeof(u8), &v);
+		}
+		return id;
+	}
+
 
 
 	script_compiler::var_ref::var_ref(context* ctx, const tokenizer::token& t, bool constant) {
@@ -96,11 +88,39 @@ namespace rs {
 
 
 
+	void script_compiler::parse_context::index_context() {
+		// the first of each name is the one that lookups found before
+		for (u32 i = 0;i < ctx->global_variables.size();i++) context_variable_names.emplace(ctx->global_variables[i].name.text, i);
+		for (u32 i = 0;i < ctx->global_functions.size();i++) context_function_names.emplace(ctx->global_functions[i]->name.text, i);
+		for (u32 i = 0;i < ctx->prototypes.size();i++) context_prototype_names.emplace(ctx->prototypes[i]->name(), i);
+	}
+
+	void script_compiler::parse_context::declare(const var_ref& ref) {
+		ref_vec& scope = locals.back();
+		local_names[ref.name.text].push_back({ u32(locals.size() - 1), u32(scope.size()) });
+		scope.push_back(ref);
+	}
+
+	void script_compiler::parse_context::declare(function_ref* func) {
+		functions.push_back(func);
+		function_names.emplace(func->name.text, func);
+	}
+
+	void script_compiler::parse_context::declare(object_prototype* proto) {
+		prototypes.push_back(proto);
+		prototype_names.emplace(proto->name(), proto);
+	}
+
 	void script_compiler::parse_context::push_locals() {
 		locals.push_back(ref_vec());
 	}
 
 	void script_compiler::parse_context::pop_locals() {
+		for (auto& ref : locals.back()) {
+			auto it = local_names.find(ref.name.text);
+			it->second.pop_back();
+			if (it->second.empty()) local_names.erase(it);
+		}
 		locals.pop_back();
 	}
 
@@ -114,66 +134,74 @@ namespace rs {
 			if (ref.name.text == name) return ref;
 		}
 
-		for (auto i = locals.rbegin();i != locals.rend();i++) {
-			ref_vec& vars = *i;
-			for (auto& ref : vars) {
-				if (ref.name.text == name) return ref;
-			}
+		auto local = local_names.find(name);
+		if (local != local_names.end()) {
+			const local_location& loc = local->second.back();
+			return locals[loc.scope][loc.index];
 		}
 
-		for (auto& i : ctx->global_variables) {
-			if (i.name.text == name) return var_ref(i);
-		}
+		auto global = context_variable_names.find(name);
+		if (global != context_variable_names.end()) return var_ref(ctx->global_variables[global->second]);
 		
 		tokenizer::token t;
 		return var_ref(nullptr, t, false);
 	}
 
 	variable_id script_compiler::parse_context::func(const string& name) {
-		for (auto* func : functions) {
-			if (func->name.text == name) return func->function_id;
-		}
+		auto it = function_names.find(name);
+		if (it != function_names.end()) return it->second->function_id;
 
-		for (auto* func : ctx->global_functions) {
-			if (func->name.text == name) {
-				return func->function_id;
-			}
-		}
+		auto global = context_function_names.find(name);
+		if (global != context_function_names.end()) return ctx->global_functions[global->second]->function_id;
 		
 		return 0;
 	}
 
 	object_prototype* script_compiler::parse_context::proto(const string& name) {
-		for (auto* proto : prototypes) {
-			if (proto->name() == name) return proto;
-		}
+		auto it = prototype_names.find(name);
+		if (it != prototype_names.end()) return it->second;
 
-		for (auto* proto : ctx->prototypes) {
-			if (proto->name() == name) return proto;
-		}
+		auto global = context_prototype_names.find(name);
+		if (global != context_prototype_names.end()) return ctx->prototypes[global->second];
 
 		return nullptr;
 	}
 
+	rs_register script_compiler::parse_context::alloc_scratch() {
+		if (scratch_count == rs_register::register_count - rs_register::scratch0) return rs_register::null_register;
+		return rs_register(rs_register::scratch0 + scratch_count++);
+	}
+
+	void script_compiler::parse_context::free_scratch(rs_register reg) {
+		if (reg != rs_register::null_register) scratch_count--;
+	}
 
 
 	bool script_compiler::compile(const std::string& code, instruction_array& instructions) {
-		tokenizer t("test", code);
-		initialize_tokenizer(t);
+		tokenizer t("test", code, script_parser::keywords());
+		syntax_tree tree;
 
 		instructions.backup();
 		try {
+			script_parser parser(t, tree);
+			parser.parse();
+			m_passes.execute(tree);
+
 			parse_context ctx;
 			ctx.ctx = m_script_context;
 			ctx.currentFunction = nullptr;
 			ctx.currentPrototype = nullptr;
 			ctx.constructingPrototype = false;
+			ctx.scratch_count = 0;
 			ctx.file = "test";
+			ctx.source = instructions.add_source(ctx.file, code);
+			ctx.tokens = &t;
 			ctx.current_scope_idx = 0;
+			ctx.index_context();
 			ctx.push_locals();
 
-			while (!t.at_end()) {
-				compile_statement(t, ctx, instructions);
+			for (ast_node* statement : tree.root->children) {
+				compile_statement(statement, ctx, instructions);
 			}
 
 			for (function_ref* func : ctx.functions) {
@@ -181,7 +209,7 @@ namespace rs {
 				f->function_id = func->function_id;
 				for (auto& p : func->params) f->params.push_back({ p.id, p.name, p.is_const });
 				for (auto& d : func->declared_vars) f->declared_vars.push(d.id);
-				m_script_context->memory->get(func->function_id).data = f;
+				m_script_context->memory->set(func->function_id, rs_builtin_type::t_function, sizeof(script_function*), f);
 				if (func->is_global) m_script_context->global_functions.push_back(f);
 			}
 
@@ -203,61 +231,14 @@ namespace rs {
 		return false;
 	}
 
-	void script_compiler::initialize_tokenizer(tokenizer& t) {
-		t.specify_keyword("function");
-		t.specify_keyword("return");
-		t.specify_keyword("const");
-		t.specify_keyword("let");
-		t.specify_keyword("if");
-		t.specify_keyword("else");
-		t.specify_keyword("while");
-		t.specify_keyword("for");
-		t.specify_keyword("else");
-		t.specify_keyword("class");
-		t.specify_keyword("extends");
-		t.specify_keyword("export");
-		t.specify_keyword("continue");
-		t.specify_keyword("break");
-		t.specify_keyword("new");
-		t.specify_keyword("static");
-		t.specify_keyword("constructor");
-		t.specify_keyword("?");
-		t.specify_keyword(":");
-		t.specify_keyword("+");
-		t.specify_keyword("-");
-		t.specify_keyword("*");
-		t.specify_keyword("/");
-		t.specify_keyword("%");
-		t.specify_keyword("^");
-		t.specify_keyword("=");
-		t.specify_keyword("!");
-		t.specify_keyword("<");
-		t.specify_keyword(">");
-		t.specify_keyword("++");
-		t.specify_keyword("--");
-		t.specify_keyword("+=");
-		t.specify_keyword("-=");
-		t.specify_keyword("*=");
-		t.specify_keyword("/=");
-		t.specify_keyword("%=");
-		t.specify_keyword("^=");
-		t.specify_keyword("==");
-		t.specify_keyword("!=");
-		t.specify_keyword("<=");
-		t.specify_keyword(">=");
-		t.specify_keyword("&&");
-		t.specify_keyword("||");
-		t.specify_keyword("=>");
-	}
-
-	void script_compiler::check_declaration(tokenizer& t, parse_context& ctx, token& declaration) {
+	void script_compiler::check_declaration(parse_context& ctx, const token& declaration) {
 		if (ctx.currentPrototype) {
 			script_function* method = ctx.currentPrototype->method(declaration.text);
 			if (method) {
 				throw parse_exception(
 					format("Cannot redeclare class method '%s', previous definition is on %s:%d", declaration.text.c_str(), method->name.file.c_str(), method->name.line + 1),
 					ctx.file,
-					t.lines[declaration.line],
+					ctx.tokens->line_text(declaration.line),
 					declaration.line,
 					declaration.col
 				);
@@ -268,7 +249,7 @@ namespace rs {
 				throw parse_exception(
 					format("Cannot redeclare static class method '%s', previous definition is on %s:%d", declaration.text.c_str(), method->name.file.c_str(), method->name.line + 1),
 					ctx.file,
-					t.lines[declaration.line],
+					ctx.tokens->line_text(declaration.line),
 					declaration.line,
 					declaration.col
 				);
@@ -281,7 +262,7 @@ namespace rs {
 						throw parse_exception(
 							format("Cannot redeclare static class variable '%s', previous definition is on %s:%d", declaration.text.c_str(), v.name.file.c_str(), v.name.line + 1),
 							ctx.file,
-							t.lines[declaration.line],
+							ctx.tokens->line_text(declaration.line),
 							declaration.line,
 							declaration.col
 						);
@@ -291,7 +272,7 @@ namespace rs {
 				throw parse_exception(
 					format("Cannot redeclare static class variable '%s'", declaration.text.c_str()),
 					ctx.file,
-					t.lines[declaration.line],
+					ctx.tokens->line_text(declaration.line),
 					declaration.line,
 					declaration.col
 				);
@@ -305,7 +286,7 @@ namespace rs {
 			throw parse_exception(
 				format("Cannot redeclare '%s', previous definition is on %s:%d", declaration.text.c_str(), existing.name.file.c_str(), existing.name.line + 1),
 				ctx.file,
-				t.lines[declaration.line],
+				ctx.tokens->line_text(declaration.line),
 				declaration.line,
 				declaration.col
 			);
@@ -314,24 +295,14 @@ namespace rs {
 		variable_id func = ctx.func(declaration.text);
 		if (func) {
 			token func_name;
-			for (auto* func : ctx.functions) {
-				if (func->name.text == declaration.text) {
-					func_name = func->name;
-					break;
-				}
-			}
-
-			for (auto* func : m_script_context->global_functions) {
-				if (func->name.text == declaration.text) {
-					func_name = func->name;
-					break;
-				}
-			}
+			auto global = ctx.context_function_names.find(declaration.text);
+			if (global != ctx.context_function_names.end()) func_name = m_script_context->global_functions[global->second]->name;
+			else func_name = ctx.function_names[declaration.text]->name;
 
 			throw parse_exception(
 				format("Cannot redeclare '%s', previous definition is on %s:%d", declaration.text.c_str(), func_name.file.c_str(), func_name.line + 1),
 				ctx.file,
-				t.lines[declaration.line],
+				ctx.tokens->line_text(declaration.line),
 				declaration.line,
 				declaration.col
 			);
@@ -342,20 +313,19 @@ namespace rs {
 			throw parse_exception(
 				format("Cannot redeclare '%s', previous definition is on %s:%d", declaration.text.c_str(), proto->declaration().file.c_str(), proto->declaration().line + 1),
 				ctx.file,
-				t.lines[declaration.line],
+				ctx.tokens->line_text(declaration.line),
 				declaration.line,
 				declaration.col
 			);
 		}
 	}
 
-	script_compiler::function_ref* script_compiler::compile_function(tokenizer& t, parse_context& ctx, instruction_array& instructions, rs_register destination, bool allow_name) {
-		instruction& jump_over = instructions.append(
+	script_compiler::function_ref* script_compiler::compile_function(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination) {
+		size_t jump_over = instructions.append(
 			instruction(rs_instruction::jump),
-			ctx.file,
-			t.line(),
-			t.col(),
-			t.lines[t.line()]
+			ctx.source,
+			node->open.line,
+			node->open.col
 		);
 
 		ref_vec params;
@@ -363,79 +333,42 @@ namespace rs {
 
 		ctx.push_locals();
 
-		auto func_name = t.identifier(false);
-		if (func_name.valid() && !allow_name) {
-			throw parse_exception(
-				"Named function can not be declared here",
-				ctx.file,
-				t.lines[func_name.line],
-				func_name.line,
-				func_name.col
-			);
-		}
-		check_declaration(t, ctx, func_name);
+		check_declaration(ctx, node->tok);
 
-		auto open_params = t.character('(');
-		for(unsigned char i = 0;i < 8;i++) {
-			auto pname = t.identifier(false);
-			if (!pname.valid()) break;
+		ast_node* body = node->children.back();
+		for (size_t i = 0;i < node->children.size() - 1;i++) {
+			const token& pname = node->children[i]->tok;
 			rs_register r = (rs_register)(rs_register::parameter0 + i);
-			ctx.locals.back().push_back(var_ref(r, pname, true));
+			ctx.declare(var_ref(r, pname, true));
 			params.push_back(var_ref(r, pname, true));
-
-			auto comma = t.character(',', false);
-			if (!comma.valid()) break;
 		}
-		auto close_params = t.character(')');
-		auto body_open = t.character('{');
 
 		function_ref* func = new function_ref;
 		func->function_id = m_script_context->memory->set_static(rs_builtin_type::t_function, sizeof(script_function*), nullptr);
-		func->name = func_name;
+		func->name = node->tok;
 		func->params = params;
 		func->instruction_offset = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &first_instruction);
 		func->is_global = !ctx.currentFunction && !ctx.currentPrototype;
 		func->has_explicit_return = false;
 		ctx.currentFunction = func;
-		if (!ctx.currentPrototype) ctx.functions.push_back(func);
-
-		bool closed = false;
-		token body_close;
-		while(!t.at_end()) {
-			body_close = t.character('}', false);
-			if (body_close.valid()) {
-				closed = true;
-				break;
-			}
-
-			compile_statement(t, ctx, instructions);
-		}
+		if (!ctx.currentPrototype) ctx.declare(func);
 
-		if (!closed) {
-			throw parse_exception(
-				"Encountered unexpected end of input while parsing function body",
-				ctx.file,
-				t.lines[body_open.line],
-				body_open.line,
-				body_open.col
-			);
-		}
+		compile_body(body, ctx, instructions);
 
+		const token& body_close = node->close;
 		if (!func->has_explicit_return) {
 			instructions.append(
 				instruction(rs_instruction::move).arg(rs_register::return_value).arg(variable_id(0)),
-				ctx.file,
+				ctx.source,
 				body_close.line,
-				body_close.col,
-				t.lines[body_close.line]
+				body_close.col
 			);
 
 			instructions.append(
 				instruction(rs_instruction::ret),
-				ctx.file,
+				ctx.source,
 				body_close.line,
-				body_close.col,
-				t.lines[body_close.line]
+				body_close.col
 			);
 		}
 
@@ -445,1646 +378,1084 @@ namespace rs {
 
 		func->instruction_count = instructions.count() - first_instruction;
 		integer_type jump_to = instructions.count();
-		variable_id  jump_to_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &jump_to);
-		jump_over.arg(jump_to_id);
+		instructions.add_imm(jump_over, jump_to);
 
 		instructions.append(
 			instruction(rs_instruction::move).arg(destination).arg(func->function_id),
-			ctx.file,
+			ctx.source,
 			body_close.line,
-			body_close.col,
-			t.lines[body_close.line]
+			body_close.col
 		);
 
 		return func;
 	}
 
-	object_prototype* script_compiler::compile_class(tokenizer& t, parse_context& ctx, instruction_array& instructions) {
-		token class_name = t.identifier();
-		token inheritance_token = t.character(':', false);
-		token inherits_class;
-		if (inheritance_token.valid()) inherits_class = t.identifier();
-
-		object_prototype* proto = new object_prototype(m_script_context, class_name);
+	object_prototype* script_compiler::compile_class(ast_node* node, parse_context& ctx, instruction_array& instructions) {
+		object_prototype* proto = new object_prototype(m_script_context, node->tok);
 		ctx.currentPrototype = proto;
 
-		token open = t.character('{');
-		token close = t.character('}', false);
-		while (!t.at_end() && !close.valid()) {
-			token static_kw = t.keyword(false, "static");
-			token ctor_kw = t.keyword(false, "constructor");
-			if (static_kw.valid()) {
-				auto var_name = t.identifier();
+		for (ast_node* member : node->children) {
+			if (member->type == ast_node_type::nt_static) {
+				const token& var_name = member->tok;
 
-				check_declaration(t, ctx, var_name);
+				check_declaration(ctx, var_name);
 
-				auto initialized = t.keyword(false, "=");
-				
 				var_ref ref = var_ref(m_script_context, var_name, false);
 
-				if (initialized.valid()) {
-					compile_expression(t, ctx, instructions, true);
+				ast_node* initializer = member->children.size() > 0 ? member->children[0] : nullptr;
+				if (initializer && initializer->type == ast_node_type::nt_expression) {
+					const token& initialized = member->open;
+					compile_expression(initializer, ctx, instructions);
 					instructions.append(
 						instruction(rs_instruction::store).arg(ref.id).arg(rs_register::rvalue),
-						ctx.file,
+						ctx.source,
 						initialized.line,
-						initialized.col,
-						t.lines[initialized.line]
+						initialized.col
 					);
-					t.character(';');
 
 					proto->static_variable(var_name.text, ref.id);
 					ctx.prototypeStaticVars.push_back(ref);
-				} else if (t.semicolon(false).valid()) {
+				} else if (!initializer) {
 					ctx.prototypeStaticVars.push_back(ref);
 					proto->static_variable(var_name.text, ref.id);
 				} else {
 					// must be a static function
-					function_ref* func = compile_function(t, ctx, instructions);
+					function_ref* func = compile_function(initializer, ctx, instructions);
 					auto f = new script_function(m_script_context, var_name, func->instruction_offset, func->instruction_count);
 					f->function_id = func->function_id;
 					for (auto& p : func->params) f->params.push_back({ p.id, p.name, p.is_const });
 					for (auto& d : func->declared_vars) f->declared_vars.push(d.id);
-					m_script_context->memory->get(func->function_id).data = f;
+					m_script_context->memory->set(func->function_id, rs_builtin_type::t_function, sizeof(script_function*), f);
 					proto->static_method(f);
 				}
-			} else if (ctor_kw.valid()) {
-				function_ref* func = compile_function(t, ctx, instructions);
-				auto f = new script_function(m_script_context, ctor_kw, func->instruction_offset, func->instruction_count);
+			} else if (member->type == ast_node_type::nt_constructor) {
+				function_ref* func = compile_function(member->children[0], ctx, instructions);
+				auto f = new script_function(m_script_context, member->tok, func->instruction_offset, func->instruction_count);
 				f->function_id = func->function_id;
 				for (auto& p : func->params) f->params.push_back({ p.id, p.name, p.is_const });
 				for (auto& d : func->declared_vars) f->declared_vars.push(d.id);
-				m_script_context->memory->get(func->function_id).data = f;
+				m_script_context->memory->set(func->function_id, rs_builtin_type::t_function, sizeof(script_function*), f);
 				proto->constructor(f);
 			} else {
-				function_ref* func = compile_function(t, ctx, instructions);
+				function_ref* func = compile_function(member, ctx, instructions);
 				auto f = new script_function(m_script_context, func->name, func->instruction_offset, func->instruction_count);
 				f->function_id = func->function_id;
 				for (auto& p : func->params) f->params.push_back({ p.id, p.name, p.is_const });
 				for (auto& d : func->declared_vars) f->declared_vars.push(d.id);
-				m_script_context->memory->get(func->function_id).data = f;
+				m_script_context->memory->set(func->function_id, rs_builtin_type::t_function, sizeof(script_function*), f);
 				proto->method(f);
 			}
-
-			close = t.character('}', false);
 		}
 
-		if (!close.valid()) {
-			throw parse_exception(
-				"Encountered unexpected end of input while parsing class body",
-				ctx.file,
-				t.lines[open.line],
-				open.line,
-				open.col
-			);
-		}
-
-		t.semicolon();
-
 		ctx.currentPrototype = nullptr;
 		ctx.prototypeStaticVars.clear();
 
 		return proto;
 	}
 
-	bool script_compiler::compile_expression(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected, rs_register destination, bool compile_lhs) {
-		if (!expected) {
-			t.backup_state();
-			instructions.backup();
-		}
+	void script_compiler::compile_expression(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination) {
+		auto& c = node->children;
 
-		bool lhs_is_const = false;
-		if (compile_lhs) {
-			bool compiled_lhs = compile_expression_value(rs_register::lvalue, t, ctx, instructions, expected, lhs_is_const);
-			if (!compiled_lhs) {
-				if (expected) {
-					throw parse_exception(
-						"Expected expression",
-						ctx.file,
-						t.lines[t.line()],
-						t.line(),
-						t.col()
+		// number that the last operator's result is known to be
+		variable_id result_constant = 0;
+
+		if (c.size() > 1 && c[1]->type == ast_node_type::nt_folded) {
+			// the first operand was folded into the operators that follow it
+			compile_operator(c[1], ctx, instructions, destination, true, result_constant);
+		} else {
+			bool lhs_is_const = compile_expression_value(c[0], rs_register::lvalue, ctx, instructions);
+
+			if (c.size() == 1) {
+				if (rs_register::lvalue != destination) {
+					instruction i = instruction(rs_instruction::move).arg(destination);
+					if (c[0]->value) i.arg(c[0]->value);
+					else i.arg(rs_register::lvalue);
+
+					instructions.append(
+						i,
+						ctx.source,
+						node->close.line,
+						node->close.col
 					);
-				} else {
-					t.restore_state();
-					instructions.restore();
 				}
-
-				return false;
+				return;
 			}
-		} else lhs_is_const = true;
 
-		auto do_operator = [&t, &ctx, &instructions, &lhs_is_const, &destination, this](rs_instruction i, const string& op_kw, bool assign, rs_register result_register = rs_register::rvalue, bool hasRhs = true) {
-			token op = t.keyword(false, op_kw);
-			if (!op.valid()) return false;
-			
-			if (assign && lhs_is_const) {
-				throw parse_exception(
-					"Left side of expression can not be assigned",
-					ctx.file,
-					t.lines[op.line],
-					op.line,
-					op.col
-				);
-			}
+			compile_operator(c[1], ctx, instructions, destination, lhs_is_const, result_constant);
+		}
+
+		for (size_t idx = 2;idx < c.size();idx++) {
+			// the result is the left side of the next operator, folded operators
+			// don't need it
+			if (destination != rs_register::lvalue && c[idx]->type != ast_node_type::nt_folded) {
+				const token& end = c[idx - 1]->close;
+				instruction i = instruction(rs_instruction::move).arg(rs_register::lvalue);
+				if (result_constant) i.arg(result_constant);
+				else i.arg(destination);
 
-			if (!hasRhs) {
 				instructions.append(
-					instruction(i).arg(rs_register::lvalue),
-					ctx.file,
-					op.line,
-					op.col,
-					t.lines[op.line]
+					i,
+					ctx.source,
+					end.line,
+					end.col
 				);
-
-				if (result_register != destination) {
-					instructions.append(
-						instruction(rs_instruction::move).arg(destination).arg(result_register),
-						ctx.file,
-						op.line,
-						op.col,
-						t.lines[op.line]
-					);
-				}
-				return true;
 			}
 
-			bool rhs_is_const = false;
-			this->compile_expression_value(rs_register::rvalue, t, ctx, instructions, true, rhs_is_const);
+			compile_operator(c[idx], ctx, instructions, destination, true, result_constant);
+		}
+	}
+
+	void script_compiler::compile_operator(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination, bool lhs_is_const, variable_id& result_constant) {
+		const token& op = node->tok;
 
+		if (node->type == ast_node_type::nt_folded) {
+			result_constant = node->value;
 			instructions.append(
-				instruction(i).arg(rs_register::lvalue).arg(rs_register::rvalue),
-				ctx.file,
+				instruction(rs_instruction::move).arg(rs_register::rvalue).arg(node->value),
+				ctx.source,
 				op.line,
-				op.col,
-				t.lines[op.line]
+				op.col
 			);
 
-			if (result_register != destination) {
+			if (destination != rs_register::rvalue) {
 				instructions.append(
-					instruction(rs_instruction::move).arg(destination).arg(result_register),
-					ctx.file,
+					instruction(rs_instruction::move).arg(destination).arg(node->value),
+					ctx.source,
 					op.line,
-					op.col,
-					t.lines[op.line]
+					op.col
 				);
 			}
+			return;
+		}
 
-			return true;
-		};
-		
-		bool compiled_op = false;
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::compare  , "==" , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::addEq    , "+=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::subEq    , "-=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::mulEq    , "*=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::divEq    , "/=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::modEq    , "%=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::powEq    , "^=" , true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::orEq     , "||=", true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::andEq    , "&&=", true );
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::lessEq   , "<=" , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::greaterEq, ">=" , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::inc      , "++" , true , rs_register::rvalue, false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::dec      , "--" , true , rs_register::rvalue, false);
-
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::store    , "=", true);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::add      , "+"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::sub      , "-"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::mul      , "*"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::div      , "/"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::mod      , "%"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::pow      , "^"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::or       , "||" , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::and      , "&&" , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::less     , "<"  , false);
-		if (!compiled_op) compiled_op = do_operator(rs_instruction::greater  , ">"  , false);
-
-		if (compiled_op) {
-			// maybe more expression to compile
-			instructions.backup();
-
-			instructions.append(
-				instruction(rs_instruction::move).arg(rs_register::lvalue).arg(destination),
+		rs_instruction i = node->op;
+		if (is_assignment(i) && lhs_is_const) {
+			throw parse_exception(
+				"Left side of expression can not be assigned",
 				ctx.file,
-				t.line(),
-				t.col(),
-				t.lines[t.line()]
+				ctx.tokens->line_text(op.line),
+				op.line,
+				op.col
 			);
+		}
 
-			bool compiled_more = compile_expression(t, ctx, instructions, false, destination, false);
-
-			if (compiled_more) instructions.commit();
-			else instructions.restore();
-
-			if (!expected) {
-				t.commit_state();
-				instructions.commit();
-			}
-			return true;
-		} else if (!compile_lhs) return false;
+		result_constant = 0;
 
-		if (rs_register::lvalue != destination) {
+		if (node->children.size() == 0) {
 			instructions.append(
-				instruction(rs_instruction::move).arg(destination).arg(rs_register::lvalue),
-				ctx.file,
-				t.line(),
-				t.col(),
-				t.lines[t.line()]
+				instruction(i).arg(rs_register::lvalue),
+				ctx.source,
+				op.line,
+				op.col
 			);
-		}
 
-		if (!expected) {
-			t.commit_state();
-			instructions.commit();
-		}
-		return true;
-
-		/*
-		object_prototype* proto = nullptr;
-		if (proto) {
-			bool is_instantiation = compile_parameter_list(t, ctx, instructions, new_kw.valid());
-			if (is_instantiation && !new_kw.valid()) {
-				throw parse_exception(
-					format("Must use 'new' to instantiate object of class '%s'", proto->name().c_str()),
-					ctx.file,
-					t.lines[identifier.line],
-					identifier.line,
-					identifier.col
+			if (rs_register::rvalue != destination) {
+				instructions.append(
+					instruction(rs_instruction::move).arg(destination).arg(rs_register::rvalue),
+					ctx.source,
+					op.line,
+					op.col
 				);
 			}
-
-			if (is_instantiation) {
-				if (proto->constructor()) {
-					instructions.append(
-						instruction(rs_instruction::newObj),
-						ctx.file,
-						new_kw.line,
-						new_kw.col,
-						t.lines[new_kw.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::addProto).arg(rs_register::lvalue).arg(proto->id()),
-						ctx.file,
-						new_kw.line,
-						new_kw.col,
-						t.lines[new_kw.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::move).arg(rs_register::this_obj).arg(rs_register::lvalue),
-						ctx.file,
-						new_kw.line,
-						new_kw.col,
-						t.lines[new_kw.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::call).arg(proto->constructor()->function_id),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::popState).arg(rs_register::lvalue),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-				}
-				else {
-					instructions.append(
-						instruction(rs_instruction::newObj),
-						ctx.file,
-						new_kw.line,
-						new_kw.col,
-						t.lines[new_kw.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::addProto).arg(rs_register::lvalue).arg(proto->id()),
-						ctx.file,
-						new_kw.line,
-						new_kw.col,
-						t.lines[new_kw.line]
-					);
-				}
-			}
-			else {
-				t.backup_state();
-				var_ref r(rs_register::null_register, token(), false);
-				r.id = proto->id();
-				r.is_const = true;
-				r.name = identifier;
-				r.reg = rs_register::null_register;
-
-				bool did_push_state = false;
-				is_const = compile_identifier(r, identifier, t, ctx, instructions, did_push_state);
-				
-				if (compile_parameter_list(t, ctx, instructions, false)) {
-					// call to function stored in static class variable
-					is_const = true;
-
-					instructions.append(
-						instruction(rs_instruction::call).arg(rs_register::lvalue),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::move).arg(rs_register::lvalue).arg(rs_register::return_value),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-
-					instructions.append(
-						instruction(rs_instruction::popState).arg(rs_register::lvalue),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-				}
-
-				if (did_push_state) {
-					instructions.append(
-						instruction(rs_instruction::popState).arg(rs_register::lvalue),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
-					);
-				}
-			}
+			return;
 		}
-		*/
-	}
 
-	bool script_compiler::compile_expression_value(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected, bool& value_is_const) {
-		if (!expected) {
-			t.backup_state();
-			instructions.backup();
+		ast_node* rhs = node->children[0];
+		if (i == rs_instruction::or || i == rs_instruction::and) {
+			compile_logical_operator(node, ctx, instructions, destination);
+			return;
 		}
 
-		auto post_compile = [&t, &ctx, &instructions, &destination, &value_is_const, this]() {
-			if (this->compile_accessor_chain(destination, t, ctx, instructions, false)) value_is_const = false;
-		};
-
-		token subexpr_open = t.character('(', false);
-		if (subexpr_open.valid()) {
-			instructions.append(
-				instruction(rs_instruction::pushState),
-				ctx.file,
-				subexpr_open.line,
-				subexpr_open.col,
-				t.lines[subexpr_open.line]
-			);
+		compile_expression_value(rhs, rs_register::rvalue, ctx, instructions);
 
-			compile_expression(t, ctx, instructions, true, destination);
+		instructions.append(
+			instruction(i).arg(rs_register::lvalue).arg(rs_register::rvalue),
+			ctx.source,
+			op.line,
+			op.col
+		);
 
-			token subexpr_close = t.character(')');
+		// store leaves the value that was stored in rvalue
+		if (i == rs_instruction::store) result_constant = rhs->value;
 
+		if (rs_register::rvalue != destination) {
 			instructions.append(
-				instruction(rs_instruction::popState).arg(destination),
-				ctx.file,
-				subexpr_close.line,
-				subexpr_close.col,
-				t.lines[subexpr_close.line]
+				instruction(rs_instruction::move).arg(destination).arg(rs_register::rvalue),
+				ctx.source,
+				op.line,
+				op.col
 			);
-
-			if (!expected) {
-				t.commit_state();
-				instructions.commit();
-			}
-
-			value_is_const = true;
-			post_compile();
-			return true;
 		}
+	}
 
-		token new_kw = t.keyword(false, "new");
-		if (new_kw.valid()) {
-			instructions.append(
-				instruction(rs_instruction::pushState),
-				ctx.file,
-				new_kw.line,
-				new_kw.col,
-				t.lines[new_kw.line]
-			);
-
-			instructions.append(
-				instruction(rs_instruction::newObj).arg(destination),
-				ctx.file,
-				new_kw.line,
-				new_kw.col,
-				t.lines[new_kw.line]
-			);
+	void script_compiler::compile_logical_operator(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination) {
+		const token& op = node->tok;
+		bool is_or = node->op == rs_instruction::or;
+
+		// the left side is in lvalue. when it decides the result, the right side
+		// is skipped and the result is loaded from a constant
+		size_t branch = instructions.append(
+			instruction(rs_instruction::branch).arg(rs_register::lvalue),
+			ctx.source,
+			op.line,
+			op.col
+		);
 
-			instructions.append(
-				instruction(rs_instruction::move).arg(rs_register::this_obj).arg(destination),
-				ctx.file,
-				new_kw.line,
-				new_kw.col,
-				t.lines[new_kw.line]
-			);
+		integer_type rhs_address = instructions.count();
+		compile_expression_value(node->children[0], rs_register::rvalue, ctx, instructions);
 
-			ctx.constructingPrototype = true;
+		// the left side didn't decide it, so this results in whether the right side is true
+		instructions.append(
+			instruction(node->op).arg(rs_register::lvalue).arg(rs_register::rvalue),
+			ctx.source,
+			op.line,
+			op.col
+		);
 
-			bool ignore = false;
-			compile_expression_value(rs_register::rvalue, t, ctx, instructions, true, ignore);
+		size_t jump_past_result = instructions.append(
+			instruction(rs_instruction::jump),
+			ctx.source,
+			op.line,
+			op.col
+		);
 
-			ctx.constructingPrototype = false;
+		integer_type decided_address = instructions.count();
+		instructions.append(
+			instruction(rs_instruction::move).arg(rs_register::rvalue).arg(static_bool(is_or)),
+			ctx.source,
+			op.line,
+			op.col
+		);
 
-			instructions.append(
-				instruction(rs_instruction::move).arg(destination).arg(rs_register::this_obj),
-				ctx.file,
-				new_kw.line,
-				new_kw.col,
-				t.lines[new_kw.line]
-			);
+		instructions.add_imm(branch, is_or ? decided_address : rhs_address);
+		instructions.add_imm(branch, is_or ? rhs_address : decided_address);
+		instructions.add_imm(jump_past_result, instructions.count());
 
+		if (rs_register::rvalue != destination) {
 			instructions.append(
-				instruction(rs_instruction::popState).arg(destination),
-				ctx.file,
-				new_kw.line,
-				new_kw.col,
-				t.lines[new_kw.line]
+				instruction(rs_instruction::move).arg(destination).arg(rs_register::rvalue),
+				ctx.source,
+				op.line,
+				op.col
 			);
-
-			if (!expected) {
-				t.commit_state();
-				instructions.commit();
-			}
-			value_is_const = true;
-			post_compile();
-			return true;
 		}
+	}
 
-		token func_kw = t.keyword(false, "function");
-		if (func_kw.valid()) {
-			compile_function(t, ctx, instructions, destination, false);
-
-			if (!expected) {
-				t.commit_state();
-				instructions.commit();
+	bool script_compiler::compile_expression_value(ast_node* node, rs_register destination, parse_context& ctx, instruction_array& instructions) {
+		auto& c = node->children;
+		switch (node->type) {
+			case ast_node_type::nt_access: {
+				bool value_is_const = compile_expression_value(c[0], destination, ctx, instructions);
+				if (compile_accessor_chain(node, 1, destination, ctx, instructions, false)) value_is_const = false;
+				return value_is_const;
 			}
+			case ast_node_type::nt_parenthesis: {
+				const token& subexpr_open = node->open;
+				const token& subexpr_close = node->close;
 
-			value_is_const = true;
-			post_compile();
-			return true;
-		}
-
-		token identifier = t.identifier(false);
-		if (identifier.valid()) {
-			var_ref var = ctx.var(identifier.text);
-			if (var.id || var.reg != rs_register::null_register) {
-				if (var.id) {
+				// a subexpression that folded into a number doesn't modify lvalue
+				if (node->value) {
 					instructions.append(
-						instruction(rs_instruction::move).arg(destination).arg(var.id),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
+						instruction(rs_instruction::move).arg(destination).arg(node->value),
+						ctx.source,
+						subexpr_open.line,
+						subexpr_open.col
 					);
-				} else {
+					return true;
+				}
+
+				// the subexpression overwrites lvalue and rvalue. when it's the right
+				// side of an operator, the left side is in lvalue and has to be kept
+				rs_register saved = rs_register::null_register;
+				if (destination != rs_register::lvalue) {
+					saved = ctx.alloc_scratch();
 					instructions.append(
-						instruction(rs_instruction::move).arg(destination).arg(var.reg),
-						ctx.file,
-						identifier.line,
-						identifier.col,
-						t.lines[identifier.line]
+						saved != rs_register::null_register ? instruction(rs_instruction::move).arg(saved).arg(rs_register::lvalue) : instruction(rs_instruction::pushState),
+						ctx.source,
+						subexpr_open.line,
+						subexpr_open.col
 					);
 				}
 
-				if (!expected) {
-					t.commit_state();
-					instructions.commit();
+				compile_expression(c[0], ctx, instructions, destination);
+
+				if (destination != rs_register::lvalue) {
+					instructions.append(
+						saved != rs_register::null_register ? instruction(rs_instruction::move).arg(rs_register::lvalue).arg(saved) : instruction(rs_instruction::popState).arg(destination),
+						ctx.source,
+						subexpr_close.line,
+						subexpr_close.col
+					);
+					ctx.free_scratch(saved);
 				}
 
-				value_is_const = var.is_const;
-				post_compile();
 				return true;
 			}
+			case ast_node_type::nt_new: {
+				const token& new_kw = node->tok;
+				instructions.append(
+					instruction(rs_instruction::pushState),
+					ctx.source,
+					new_kw.line,
+					new_kw.col
+				);
 
-			variable_id func = ctx.func(identifier.text);
-			if (func) {
 				instructions.append(
-					instruction(rs_instruction::move).arg(destination).arg(func),
-					ctx.file,
-					identifier.line,
-					identifier.col,
-					t.lines[identifier.line]
+					instruction(rs_instruction::newObj).arg(destination),
+					ctx.source,
+					new_kw.line,
+					new_kw.col
 				);
 
-				if (!expected) {
-					t.commit_state();
-					instructions.commit();
-				}
+				instructions.append(
+					instruction(rs_instruction::move).arg(rs_register::this_obj).arg(destination),
+					ctx.source,
+					new_kw.line,
+					new_kw.col
+				);
 
-				value_is_const = true;
-				post_compile();
-				return true;
-			}
+				ctx.constructingPrototype = true;
+
+				compile_expression_value(c[0], rs_register::rvalue, ctx, instructions);
+
+				ctx.constructingPrototype = false;
 
-			object_prototype* proto = ctx.proto(identifier.text);
-			if (proto) {
 				instructions.append(
-					instruction(rs_instruction::move).arg(destination).arg(proto->id()),
-					ctx.file,
-					identifier.line,
-					identifier.col,
-					t.lines[identifier.line]
+					instruction(rs_instruction::move).arg(destination).arg(rs_register::this_obj),
+					ctx.source,
+					new_kw.line,
+					new_kw.col
 				);
 
-				if (!expected) {
-					t.commit_state();
-					instructions.commit();
-				}
+				instructions.append(
+					instruction(rs_instruction::popState).arg(destination),
+					ctx.source,
+					new_kw.line,
+					new_kw.col
+				);
 
-				value_is_const = true;
-				post_compile();
 				return true;
 			}
+			case ast_node_type::nt_function: {
+				compile_function(node, ctx, instructions, destination);
+				return true;
+			}
+			case ast_node_type::nt_identifier: {
+				const token& identifier = node->tok;
+				var_ref var = ctx.var(identifier.text);
+				if (var.id || var.reg != rs_register::null_register) {
+					if (var.id) {
+						instructions.append(
+							instruction(rs_instruction::move).arg(destination).arg(node->value ? node->value : var.id),
+							ctx.source,
+							identifier.line,
+							identifier.col
+						);
+					} else {
+						instructions.append(
+							instruction(rs_instruction::move).arg(destination).arg(var.reg),
+							ctx.source,
+							identifier.line,
+							identifier.col
+						);
+					}
+
+					return var.is_const;
+				}
+
+				variable_id func = ctx.func(identifier.text);
+				if (func) {
+					instructions.append(
+						instruction(rs_instruction::move).arg(destination).arg(func),
+						ctx.source,
+						identifier.line,
+						identifier.col
+					);
+
+					return true;
+				}
+
+				object_prototype* proto = ctx.proto(identifier.text);
+				if (proto) {
+					instructions.append(
+						instruction(rs_instruction::move).arg(destination).arg(proto->id()),
+						ctx.source,
+						identifier.line,
+						identifier.col
+					);
+
+					return true;
+				}
 
-			if (expected) {
 				throw parse_exception(
 					format("Use of undeclared identifier '%s'", identifier.text.c_str()),
 					ctx.file,
-					t.lines[identifier.line],
+					ctx.tokens->line_text(identifier.line),
 					identifier.line,
 					identifier.col
 				);
-			} else {
-				t.restore_state();
-				instructions.restore();
 			}
-			return false;
-		}
+			case ast_node_type::nt_number: {
+				const token& const_token = node->tok;
+				variable_id var = node->value ? node->value : define_static_number(m_script_context, const_token);
 
-		token const_token = t.number_constant(false);
-		if (const_token.valid()) {
-			variable_id var = define_static_number(m_script_context, const_token, ctx, t);
-
-			instructions.append(
-				instruction(rs_instruction::move).arg(destination).arg(var),
-				ctx.file,
-				identifier.line,
-				identifier.col,
-				t.lines[identifier.line]
-			);
+				instructions.append(
+					instruction(rs_instruction::move).arg(destination).arg(var),
+					ctx.source,
+					const_token.line,
+					const_token.col
+				);
 
-			if (!expected) {
-				t.commit_state();
-				instructions.commit();
+				return true;
 			}
-
-			value_is_const = true;
-			post_compile();
-			return true;
-		}
-		else {
-			const_token = t.string_constant(false, true);
-			if (const_token.valid()) {
+			case ast_node_type::nt_string: {
+				const token& const_token = node->tok;
 				variable_id var = define_static_string(m_script_context, const_token.text);
 
 				instructions.append(
 					instruction(rs_instruction::move).arg(destination).arg(var),
-					ctx.file,
-					identifier.line,
-					identifier.col,
-					t.lines[identifier.line]
+					ctx.source,
+					const_token.line,
+					const_token.col
 				);
 
-				if (!expected) {
-					t.commit_state();
-					instructions.commit();
-				}
-
-				value_is_const = true;
-				post_compile();
 				return true;
 			}
-			else {
-				if (!compile_json(destination, t, ctx, instructions, false)) {
-					if (expected) {
-						t.restore_state();
-						instructions.restore();
-						throw parse_exception(
-							"Expected expression",
-							ctx.file,
-							t.lines[t.line()],
-							t.line(),
-							t.col()
-						);
-					} else {
-						t.restore_state();
-						instructions.restore();
-					}
-
-					value_is_const = true;
-					post_compile();
-					return false;
-				} else {
-					if (!expected) {
-						t.commit_state();
-						instructions.commit();
-					}
-
-					return true;
-				}
+			case ast_node_type::nt_object: {
+				compile_json(node, destination, ctx, instructions);
+				return false;
 			}
-		}
-
-		if (!expected) {
-			t.restore_state();
-			instructions.restore();
+			default: break;
 		}
 
 		return false;
 	}
 
-	bool script_compiler::compile_accessor_chain(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool is_nested) {
-		token prop_access = t.character('.', false);
-		if (prop_access.valid()) {
+	bool script_compiler::compile_accessor_chain(ast_node* node, size_t idx, rs_register destination, parse_context& ctx, instruction_array& instructions, bool is_nested) {
+		if (idx >= node->children.size()) return false;
+		ast_node* accessor = node->children[idx];
+
+		if (accessor->type == ast_node_type::nt_member) {
+			const token& prop_access = accessor->open;
+			const token& prop_name = accessor->tok;
+			const token& assign = accessor->close;
+
+			// the chain changes this_obj
+			rs_register saved = rs_register::null_register;
 			if (!is_nested) {
+				saved = ctx.alloc_scratch();
 				instructions.append(
-					instruction(rs_instruction::pushState),
-					ctx.file,
+					saved != rs_register::null_register ? instruction(rs_instruction::move).arg(saved).arg(rs_register::this_obj) : instruction(rs_instruction::pushState),
+					ctx.source,
 					prop_access.line,
-					prop_access.col,
-					t.lines[prop_access.line]
+					prop_access.col
 				);
 			}
 
-			token prop_name = t.identifier();
-
-			t.backup_state();
-			token assign = t.keyword(false, "=");
-			t.restore_state();
-
 			if (!ctx.constructingPrototype) {
 				instructions.append(
 					instruction(rs_instruction::move).arg(rs_register::this_obj).arg(destination),
-					ctx.file,
+					ctx.source,
 					prop_name.line,
-					prop_name.col,
-					t.lines[prop_name.line]
+					prop_name.col
 				);
 			}
 
 			instructions.append(
-				instruction(assign.valid() ? rs_instruction::propAssign : rs_instruction::prop).arg(destination).arg(define_static_string(ctx.ctx, prop_name.text)),
-				ctx.file,
+				instruction(assign.valid() ? rs_instruction::propAssign : rs_instruction::prop).arg(destination).arg(define_static_string(ctx.ctx, prop_name.text)).imm(instructions.add_property_cache(ctx.ctx->atoms->get(prop_name.text))),
+				ctx.source,
 				assign.valid() ? assign.line : prop_name.line,
-				assign.valid() ? assign.col : prop_name.col,
-				t.lines[assign.valid() ? assign.line : prop_name.line]
+				assign.valid() ? assign.col : prop_name.col
 			);
 
-			if (!assign.valid()) compile_accessor_chain(destination, t, ctx, instructions, true);
+			if (!assign.valid()) compile_accessor_chain(node, idx + 1, destination, ctx, instructions, true);
 
 			if (!is_nested) {
 				instructions.append(
-					instruction(rs_instruction::popState).arg(destination),
-					ctx.file,
+					saved != rs_register::null_register ? instruction(rs_instruction::move).arg(rs_register::this_obj).arg(saved) : instruction(rs_instruction::popState).arg(destination),
+					ctx.source,
 					prop_access.line,
-					prop_access.col,
-					t.lines[prop_access.line]
+					prop_access.col
 				);
+				ctx.free_scratch(saved);
 			}
 
 			return true;
 		}
 
-		token prop_index = t.character('[', false);
-		if (prop_index.valid()) {
+		if (accessor->type == ast_node_type::nt_index) {
+			const token& prop_index = accessor->close;
+			const token& assign = accessor->tok;
+
 			instructions.append(
 				instruction(rs_instruction::pushState),
-				ctx.file,
-				prop_index.line,
-				prop_index.col,
-				t.lines[prop_index.line]
+				ctx.source,
+				accessor->open.line,
+				accessor->open.col
 			);
 
-			compile_expression(t, ctx, instructions, true, rs_register::rvalue);
-
-			prop_index = t.character(']');
-
-			t.backup_state();
-			token assign = t.keyword(false, "=");
-			t.restore_state();
+			compile_expression(accessor->children[0], ctx, instructions, rs_register::rvalue);
 
 			if (!ctx.constructingPrototype) {
 				instructions.append(
 					instruction(rs_instruction::move).arg(rs_register::this_obj).arg(destination),
-					ctx.file,
+					ctx.source,
 					prop_index.line,
-					prop_index.col,
-					t.lines[prop_index.line]
+					prop_index.col
 				);
 			}
 
 			instructions.append(
 				instruction(assign.valid() ? rs_instruction::propAssign : rs_instruction::prop).arg(destination).arg(rs_register::rvalue),
-				ctx.file,
+				ctx.source,
 				assign.valid() ? assign.line : prop_index.line,
-				assign.valid() ? assign.col : prop_index.col,
-				t.lines[assign.valid() ? assign.line : prop_index.line]
+				assign.valid() ? assign.col : prop_index.col
 			);
 
 			instructions.append(
 				instruction(rs_instruction::popState).arg(destination),
-				ctx.file,
+				ctx.source,
 				prop_index.line,
-				prop_index.col,
-				t.lines[prop_index.line]
+				prop_index.col
 			);
 
-			if (!assign.valid()) compile_accessor_chain(destination, t, ctx, instructions, is_nested);
+			if (!assign.valid()) compile_accessor_chain(node, idx + 1, destination, ctx, instructions, is_nested);
 
 			return true;
 		}
 
-		// maybe function call?
-		t.backup_state();
-		token par_open = t.character('(', false);
-		t.restore_state();
-
-		if (this->compile_parameter_list(t, ctx, instructions, par_open.valid())) {
-			if (ctx.constructingPrototype) {
-				instructions.append(
-					instruction(rs_instruction::addProto).arg(rs_register::this_obj).arg(destination),
-					ctx.file,
-					par_open.line,
-					par_open.col,
-					t.lines[par_open.line]
-				);
-			}
+		// function call
+		const token& par_open = accessor->open;
+		rs_register callee = destination;
+		compile_parameter_list(accessor, ctx, instructions, callee);
 
+		if (ctx.constructingPrototype) {
 			instructions.append(
-				instruction(rs_instruction::call).arg(destination),
-				ctx.file,
+				instruction(rs_instruction::addProto).arg(rs_register::this_obj).arg(callee),
+				ctx.source,
 				par_open.line,
-				par_open.col,
-				t.lines[par_open.line]
+				par_open.col
 			);
+		}
 
-			if (!ctx.constructingPrototype) {
-				instructions.append(
-					instruction(rs_instruction::move).arg(destination).arg(rs_register::return_value),
-					ctx.file,
-					par_open.line,
-					par_open.col,
-					t.lines[par_open.line]
-				);
+		instructions.append(
+			instruction(rs_instruction::call).arg(callee),
+			ctx.source,
+			par_open.line,
+			par_open.col
+		);
 
-				instructions.append(
-					instruction(rs_instruction::popState).arg(destination),
-					ctx.file,
-					par_open.line,
-					par_open.col,
-					t.lines[par_open.line]
-				);
-			} else {
-				instructions.append(
-					instruction(rs_instruction::popState),
-					ctx.file,
-					par_open.line,
-					par_open.col,
-					t.lines[par_open.line]
-				);
-			}
+		if (!ctx.constructingPrototype) {
+			instructions.append(
+				instruction(rs_instruction::move).arg(destination).arg(rs_register::return_value),
+				ctx.source,
+				par_open.line,
+				par_open.col
+			);
 
-			return compile_accessor_chain(destination, t, ctx, instructions, false);
+			instructions.append(
+				instruction(rs_instruction::popState).arg(destination),
+				ctx.source,
+				par_open.line,
+				par_open.col
+			);
+		} else {
+			instructions.append(
+				instruction(rs_instruction::popState),
+				ctx.source,
+				par_open.line,
+				par_open.col
+			);
 		}
 
-		return false;
+		return compile_accessor_chain(node, idx + 1, destination, ctx, instructions, false);
 	}
 
-	bool script_compiler::compile_statement(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool parseSemicolon) {
-		// Statements can start with:
-		//	- return, if, while, for, const, let
-		//	- expressions (but the result will be ignored by the rest of the code)
+	void script_compiler::compile_statement(ast_node* node, parse_context& ctx, instruction_array& instructions) {
+		if (!node) return;
 
-		t.backup_state();
-
-		auto kw = t.keyword(false);
-		if (kw.valid()) {
-			if (kw.text == "return") {
+		auto& c = node->children;
+		const token& kw = node->tok;
+		switch (node->type) {
+			case ast_node_type::nt_return: {
 				if (!ctx.currentFunction) {
 					throw parse_exception(
 						"Encountered unexpected return statement",
 						ctx.file,
-						t.lines[kw.line],
+						ctx.tokens->line_text(kw.line),
 						kw.line,
 						kw.col
 					);
 				}
 
-				if (compile_expression(t, ctx, instructions, false)) {
+				if (c.size() > 0) {
+					compile_expression(c[0], ctx, instructions);
 					instructions.append(
 						instruction(rs_instruction::move).arg(rs_register::return_value).arg(rs_register::rvalue),
-						ctx.file,
+						ctx.source,
 						kw.line,
-						kw.col,
-						t.lines[kw.line]
+						kw.col
 					);
 				} else {
 					instructions.append(
 						instruction(rs_instruction::move).arg(rs_register::return_value).arg(variable_id(0)),
-						ctx.file,
+						ctx.source,
 						kw.line,
-						kw.col,
-						t.lines[kw.line]
+						kw.col
 					);
 				}
 				instructions.append(
 					instruction(rs_instruction::ret),
-					ctx.file,
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
-				if (parseSemicolon) t.character(';');
 
 				ctx.currentFunction->has_explicit_return = true;
+				break;
 			}
-			else if (kw.text == "if") {
+			case ast_node_type::nt_if: {
 				ctx.current_scope_idx++;
-				t.character('(');
-				compile_expression(t, ctx, instructions, true);
-				t.character(')');
+				compile_expression(c[0], ctx, instructions);
 
 				integer_type pass_address = instructions.count() + 1;
-				variable_id pass_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &pass_address);
 
-				instruction& branch = instructions.append(
-					instruction(rs_instruction::branch).arg(rs_register::rvalue).arg(pass_addr_id),
-					ctx.file,
+				size_t branch = instructions.append(
+					instruction(rs_instruction::branch).arg(rs_register::rvalue).imm(pass_address),
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
 
 				instructions.append(
 					instruction(rs_instruction::pushScope),
-					ctx.file,
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
 
-				token final_token;
-				auto block_open = t.character('{', false);
-				if (block_open.valid()) {
-					ctx.push_locals();
-					token closed;
-					while (!t.at_end()) {
-						closed = t.character('}', false);
-						if (closed.valid()) break;
-						compile_statement(t, ctx, instructions);
-					}
-					if (!closed.valid()) {
-						throw parse_exception(
-							"Encountered unexpected end of input while parsing 'if' statement body",
-							ctx.file,
-							t.lines[block_open.line],
-							block_open.line,
-							block_open.col
-						);
-					}
-					final_token = closed;
+				ast_node* body = c[1];
+				const token& final_token = body->close;
+				bool block = body->type == ast_node_type::nt_block;
+				if (block) ctx.push_locals();
+				compile_body(body, ctx, instructions);
 
-					instructions.append(
-						instruction(rs_instruction::popScope),
-						ctx.file,
-						closed.line,
-						closed.col,
-						t.lines[closed.line]
-					);
-
-					integer_type fail_address = instructions.count() + 1;
-					variable_id fail_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &fail_address);
-					branch.arg(fail_addr_id);
-					ctx.pop_locals();
-				} else {
-					compile_statement(t, ctx, instructions, false);
-					if (parseSemicolon) {
-						final_token = t.semicolon();
-						instructions.append(
-							instruction(rs_instruction::popScope),
-							ctx.file,
-							final_token.line,
-							final_token.col,
-							t.lines[final_token.line]
-						);
-					} else {
-						final_token.line = t.line();
-						final_token.col = t.col();
-
-						instructions.append(
-							instruction(rs_instruction::popScope),
-							ctx.file,
-							t.line(),
-							t.col(),
-							t.lines[t.line()]
-						);
-					}
+				instructions.append(
+					instruction(rs_instruction::popScope),
+					ctx.source,
+					final_token.line,
+					final_token.col
+				);
 
-					integer_type fail_address = instructions.count() + 1;
-					variable_id fail_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &fail_address);
-					branch.arg(fail_addr_id);
-				}
+				integer_type fail_address = instructions.count() + 1;
+				instructions.add_imm(branch, fail_address);
+				if (block) ctx.pop_locals();
 
-				instruction& jump_past_else = instructions.append(
+				size_t jump_past_else = instructions.append(
 					instruction(rs_instruction::null_instruction),
-					ctx.file,
+					ctx.source,
 					final_token.line,
-					final_token.col,
-					t.lines[final_token.line]
+					final_token.col
 				);
-				token else_kw = t.keyword(false, "else");
-				if (else_kw.valid()) {
-					auto block_open = t.character('{', false);
-					if (block_open.valid()) {
-						ctx.push_locals();
-						token closed;
-						while (!t.at_end()) {
-							closed = t.character('}', false);
-							if (closed.valid()) break;
-							compile_statement(t, ctx, instructions);
-						}
-						if (!closed.valid()) {
-							throw parse_exception(
-								"Encountered unexpected end of input while parsing 'else' statement body",
-								ctx.file,
-								t.lines[block_open.line],
-								block_open.line,
-								block_open.col
-							);
-						}
 
-						instructions.append(
-							instruction(rs_instruction::popScope),
-							ctx.file,
-							closed.line,
-							closed.col,
-							t.lines[closed.line]
-						);
+				if (c.size() > 2) {
+					ast_node* else_body = c[2];
+					const token& closed = else_body->close;
+					block = else_body->type == ast_node_type::nt_block;
+					if (block) ctx.push_locals();
+					compile_body(else_body, ctx, instructions);
 
-						integer_type after_pass_address = instructions.count() + 1;
-						variable_id after_pass_address_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &after_pass_address);
-						jump_past_else.arg(after_pass_address_id);
-						jump_past_else.code = rs_instruction::jump;
-						ctx.pop_locals();
-					} else {
-						compile_statement(t, ctx, instructions, false);
-
-						if (parseSemicolon) {
-							auto sc = t.semicolon();
-							instructions.append(
-								instruction(rs_instruction::popScope),
-								ctx.file,
-								sc.line,
-								sc.col,
-								t.lines[sc.line]
-							);
-						} else {
-							instructions.append(
-								instruction(rs_instruction::popScope),
-								ctx.file,
-								t.line(),
-								t.col(),
-								t.lines[t.line()]
-							);
-						}
-
-						integer_type after_pass_address = instructions.count();
-						variable_id after_pass_address_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &after_pass_address);
-						jump_past_else.arg(after_pass_address_id);
-						jump_past_else.code = rs_instruction::jump;
-					}
+					instructions.append(
+						instruction(rs_instruction::popScope),
+						ctx.source,
+						closed.line,
+						closed.col
+					);
+
+					integer_type after_pass_address = block ? instructions.count() + 1 : instructions.count();
+					instructions.add_imm(jump_past_else, after_pass_address);
+					instructions.set_code(jump_past_else, rs_instruction::jump);
+					if (block) ctx.pop_locals();
 				}
 
 				ctx.current_scope_idx--;
+				break;
 			}
-			else if (kw.text == "while") {
+			case ast_node_type::nt_while: {
 				ctx.current_scope_idx++;
 				integer_type expr_address = instructions.count() + 1;
-				variable_id expr_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &expr_address);
 
-				t.character('(');
-				compile_expression(t, ctx, instructions, true);
-				t.character(')');
+				compile_expression(c[0], ctx, instructions);
 
 				integer_type pass_address = instructions.count() + 1;
-				variable_id pass_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &pass_address);
 
-				instruction& branch = instructions.append(
-					instruction(rs_instruction::branch).arg(rs_register::rvalue).arg(pass_addr_id),
-					ctx.file,
+				size_t branch = instructions.append(
+					instruction(rs_instruction::branch).arg(rs_register::rvalue).imm(pass_address),
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
 
-				auto block_open = t.character('{', false);
-				if (block_open.valid()) {
+				ast_node* body = c[1];
+				if (body->type == ast_node_type::nt_block) {
 					ctx.push_locals();
 					instructions.append(
 						instruction(rs_instruction::pushScope),
-						ctx.file,
-						block_open.line,
-						block_open.col,
-						t.lines[block_open.line]
+						ctx.source,
+						body->open.line,
+						body->open.col
 					);
 
-					token closed;
-					while (!t.at_end()) {
-						closed = t.character('}', false);
-						if (closed.valid()) break;
-
-						compile_statement(t, ctx, instructions);
-					}
-					if (!closed.valid()) {
-						throw parse_exception(
-							"Encountered unexpected end of input while parsing 'for' loop body",
-							ctx.file,
-							t.lines[block_open.line],
-							block_open.line,
-							block_open.col
-						);
-					}
+					compile_body(body, ctx, instructions);
 
 					instructions.append(
 						instruction(rs_instruction::popScope),
-						ctx.file,
-						closed.line,
-						closed.col,
-						t.lines[closed.line]
+						ctx.source,
+						body->close.line,
+						body->close.col
 					);
 					ctx.pop_locals();
-				} else {
-					compile_statement(t, ctx, instructions, parseSemicolon);
-				}
+				} else compile_body(body, ctx, instructions);
 
 				instructions.append(
-					instruction(rs_instruction::store).arg(rs_register::instruction_address).arg(expr_addr_id),
-					ctx.file,
+					instruction(rs_instruction::jump).imm(expr_address),
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
 
 				integer_type fail_address = instructions.count();
-				variable_id fail_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &fail_address);
-				branch.arg(fail_addr_id);
+				instructions.add_imm(branch, fail_address);
 
 				ctx.current_scope_idx--;
+				break;
 			}
-			else if (kw.text == "for") {
+			case ast_node_type::nt_for: {
 				ctx.current_scope_idx++;
-				auto open = t.character('(');
+				const token& open = node->open;
 				ctx.push_locals();
 				instructions.append(
 					instruction(rs_instruction::pushScope),
-					ctx.file,
+					ctx.source,
 					open.line,
-					open.col,
-					t.lines[open.line]
+					open.col
 				);
 
-				auto sc = t.semicolon(false);
-				if (!sc.valid()) {
-					compile_statement(t, ctx, instructions);
-				}
+				compile_statement(c[0], ctx, instructions);
 				integer_type expr_address = instructions.count();
-				variable_id expr_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &expr_address);
 
-				sc = t.semicolon(false);
-				if (!sc.valid()) {
-					compile_expression(t, ctx, instructions, true);
-					t.semicolon();
-				}
+				if (c[1]) compile_expression(c[1], ctx, instructions);
 
 				integer_type pass_address = instructions.count() + 1;
-				variable_id pass_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &pass_address);
 
-				instruction& branch = instructions.append(
-					instruction(rs_instruction::branch).arg(rs_register::rvalue).arg(pass_addr_id),
-					ctx.file,
+				size_t branch = instructions.append(
+					instruction(rs_instruction::branch).arg(rs_register::rvalue).imm(pass_address),
+					ctx.source,
 					kw.line,
-					kw.col,
-					t.lines[kw.line]
+					kw.col
 				);
 
-				auto end_paren = t.character(')', false);
-				if (!end_paren.valid()) {
-					compile_statement(t, ctx, instructions, false);
-					t.character(')');
-				}
+				compile_statement(c[2], ctx, instructions);
 
-				auto block_open = t.character('{', false);
-				if (block_open.valid()) {
-					token closed;
-					while (!t.at_end()) {
-						closed = t.character('}', false);
-						if (closed.valid()) break;
+				ast_node* body = c[3];
+				const token& closed = body->close;
+				compile_body(body, ctx, instructions);
 
-						compile_statement(t, ctx, instructions);
-					}
-					if (!closed.valid()) {
-						throw parse_exception(
-							"Encountered unexpected end of input while parsing 'for' loop body",
-							ctx.file,
-							t.lines[block_open.line],
-							block_open.line,
-							block_open.col
-						);
-					}
-
-					instructions.append(
-						instruction(rs_instruction::store).arg(rs_register::instruction_address).arg(expr_addr_id),
-						ctx.file,
-						closed.line,
-						closed.col,
-						t.lines[closed.line]
-					);
-
-					integer_type fail_address = instructions.count();
-					variable_id fail_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &fail_address);
-					branch.arg(fail_addr_id);
-
-					instructions.append(
-						instruction(rs_instruction::popScope),
-						ctx.file,
-						closed.line,
-						closed.col,
-						t.lines[closed.line]
-					);
-				} else {
-					compile_statement(t, ctx, instructions, false);
-					auto sc = parseSemicolon ? t.character(';') : token();
+				instructions.append(
+					instruction(rs_instruction::jump).imm(expr_address),
+					ctx.source,
+					closed.line,
+					closed.col
+				);
 
-					instructions.append(
-						instruction(rs_instruction::store).arg(rs_register::instruction_address).arg(expr_addr_id),
-						ctx.file,
-						sc.valid() ? sc.line : t.line(),
-						sc.valid() ? sc.col : t.col(),
-						t.lines[sc.valid() ? sc.line : t.line()]
-					);
+				integer_type fail_address = instructions.count();
+				instructions.add_imm(branch, fail_address);
 
-					integer_type fail_address = instructions.count();
-					variable_id fail_addr_id = m_script_context->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &fail_address);
-					branch.arg(fail_addr_id);
+				instructions.append(
+					instruction(rs_instruction::popScope),
+					ctx.source,
+					closed.line,
+					closed.col
+				);
 
-					instructions.append(
-						instruction(rs_instruction::popScope),
-						ctx.file,
-						sc.valid() ? sc.line : t.line(),
-						sc.valid() ? sc.col : t.col(),
-						t.lines[sc.valid() ? sc.line : t.line()]
-					);
-				}
 				ctx.current_scope_idx--;
+				break;
 			}
-			else if (kw.text == "const") {
-				t.backup_state();
-				auto var_name = t.identifier();
-				bool uninitialized = t.semicolon(false).valid();
-				// expression parser needs to see this too
-				t.restore_state();
-				
-				check_declaration(t, ctx, var_name);
-				
+			case ast_node_type::nt_const: {
+				const token& var_name = node->tok;
+				check_declaration(ctx, var_name);
+
 				// Variable should be non-const initially to allow
 				// the initializer expression to assign a value to it
 				var_ref ref = var_ref(m_script_context, var_name, false);
-				ctx.locals.back().push_back(ref);
-				if (!uninitialized) compile_expression(t, ctx, instructions, true);
+				ctx.declare(ref);
+				if (c.size() > 0) compile_expression(c[0], ctx, instructions);
 				ctx.locals.back().back().is_const = true;
 				ref.is_const = true;
 
 				if (ctx.currentFunction) ctx.currentFunction->declared_vars.push_back(ref);
 				else if (ctx.current_scope_idx == 0) m_script_context->global_variables.push_back({ ref.id, ref.name, ref.is_const });
-
-				if (parseSemicolon) t.character(';');
+				break;
 			}
-			else if (kw.text == "let") {
-				t.backup_state();
-				auto var_name = t.identifier();
-				bool uninitialized = t.semicolon(false).valid();
-				// expression parser needs to see this too
-				t.restore_state();
-				
-				check_declaration(t, ctx, var_name);
+			case ast_node_type::nt_let: {
+				const token& var_name = node->tok;
+				check_declaration(ctx, var_name);
 
 				auto ref = var_ref(m_script_context, var_name, false);
-				ctx.locals.back().push_back(ref);
+				ctx.declare(ref);
 				if (ctx.currentFunction) ctx.currentFunction->declared_vars.push_back(ref);
 				else if (ctx.current_scope_idx == 0) m_script_context->global_variables.push_back({ ref.id, ref.name, ref.is_const });
 
-				if (!uninitialized) compile_expression(t, ctx, instructions, true);
-				if (parseSemicolon) t.character(';');
-			}
-			else if (kw.text == "else") {
-				throw parse_exception(
-					"Encountered 'else' without an 'if'",
-					ctx.file,
-					t.lines[kw.line],
-					kw.line,
-					kw.col
-				);
+				if (c.size() > 0) compile_expression(c[0], ctx, instructions);
+				else {
+					// allocate it in the scope it's declared in, rather than wherever it's first assigned
+					instructions.append(
+						instruction(rs_instruction::store).arg(ref.id).arg(variable_id(0)),
+						ctx.source,
+						var_name.line,
+						var_name.col
+					);
+				}
+				break;
 			}
-			else if (kw.text == "class") {
+			case ast_node_type::nt_class: {
 				if (ctx.currentFunction) {
 					throw parse_exception(
 						"Classes can only be defined at the global scope",
 						ctx.file,
-						t.lines[kw.line],
-						kw.line,
-						kw.col
+						ctx.tokens->line_text(node->open.line),
+						node->open.line,
+						node->open.col
 					);
 				}
-				object_prototype* proto = compile_class(t, ctx, instructions);
-				ctx.prototypes.push_back(proto);
+				object_prototype* proto = compile_class(node, ctx, instructions);
+				ctx.declare(proto);
+				break;
 			}
-			else if (kw.text == "function") {
-				compile_function(t, ctx, instructions);
+			case ast_node_type::nt_function: {
+				compile_function(node, ctx, instructions);
+				break;
 			}
-			else if (kw.text == "new") {
-				t.restore_state();
-				bool compiled = compile_expression(t, ctx, instructions, true);
-				if (parseSemicolon) t.character(';');
-
-				return compiled;
+			case ast_node_type::nt_expression: {
+				compile_expression(node, ctx, instructions);
+				break;
 			}
-			else false;
-
-			return true;
+			default: break;
 		}
-
-		t.restore_state();
-		bool compiled = compile_expression(t, ctx, instructions, true);
-		if (parseSemicolon) t.character(';');
-
-		return compiled;
 	}
 
-	bool script_compiler::compile_identifier(const var_ref& variable, const tokenizer::token& reference, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool& pushed_state) {
-		if (reference.valid()) {
-			auto i = instruction(rs_instruction::move).arg(rs_register::lvalue);
-			if (variable.id) i.arg(variable.id);
-			else i.arg(variable.reg);
-			instructions.append(
-				i,
-				ctx.file,
-				reference.line,
-				reference.col,
-				t.lines[reference.line]
-			);
+	void script_compiler::compile_body(ast_node* node, parse_context& ctx, instruction_array& instructions) {
+		for (ast_node* statement : node->children) {
+			compile_statement(statement, ctx, instructions);
 		}
-		
-		auto accessor_operator = t.character('.', false);
-		if (accessor_operator.valid()) {
-			auto prop_name = t.identifier();
-			variable_id vid = define_static_string(m_script_context, prop_name.text);
-
-			if (!pushed_state) {
-				instructions.append(
-					instruction(rs_instruction::pushState),
-					ctx.file,
-					accessor_operator.line,
-					accessor_operator.col,
-					t.lines[accessor_operator.line]
-				);
-				pushed_state = true;
-			}
+	}
 
-			instructions.append(
-				instruction(rs_instruction::move).arg(rs_register::this_obj).arg(rs_register::lvalue),
-				ctx.file,
-				accessor_operator.line,
-				accessor_operator.col,
-				t.lines[accessor_operator.line]
-			);
+	void script_compiler::compile_parameter_list(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register& callee) {
+		const token& popen = node->open;
+		instructions.append(
+			instruction(rs_instruction::pushState),
+			ctx.source,
+			popen.line,
+			popen.col
+		);
 
-			instruction& prop = instructions.append(
-				instruction(rs_instruction::prop).arg(rs_register::lvalue).arg(vid),
-				ctx.file,
-				prop_name.line,
-				prop_name.col,
-				t.lines[prop_name.line]
-			);
+		// the state that was just pushed has its own scratch registers
+		u8 outer_scratch_count = ctx.scratch_count;
+		ctx.scratch_count = 0;
 
+		instructions.append(
+			instruction(rs_instruction::clearParams),
+			ctx.source,
+			popen.line,
+			popen.col
+		);
 
-			t.backup_state();
-			token assignment = t.keyword(false, "=");
-			t.restore_state();
-			if (assignment.valid()) {
-				// this property on the object is being assigned
-				prop.code = rs_instruction::propAssign;
-			} else {
-				compile_identifier(var_ref(m_script_context, tokenizer::token(), false), tokenizer::token(), t, ctx, instructions, pushed_state);
-				// lvalue will now be pointing to the accessed variable at the
-				// end of the accessor path
+		// the arguments are compiled in the state that the call is made from,
+		// they overwrite lvalue and rvalue
+		rs_register saved = rs_register::null_register;
+		bool has_args = node->children.size() > 0;
+		if (has_args && (callee == rs_register::lvalue || callee == rs_register::rvalue)) {
+			saved = ctx.alloc_scratch();
+			if (saved != rs_register::null_register) {
+				instructions.append(
+					instruction(rs_instruction::move).arg(saved).arg(callee),
+					ctx.source,
+					popen.line,
+					popen.col
+				);
+				callee = saved;
 			}
-
-			return false;
 		}
 
-		auto index_open_operator = t.character('[', false);
-		if (index_open_operator.valid()) {
-			if (!pushed_state) {
+		for (size_t p = 0;p < node->children.size();p++) {
+			ast_node* arg = node->children[p];
+			rs_register param = rs_register(rs_register::parameter0 + p);
+
+			if (saved == rs_register::null_register) {
 				instructions.append(
 					instruction(rs_instruction::pushState),
-					ctx.file,
-					accessor_operator.line,
-					accessor_operator.col,
-					t.lines[accessor_operator.line]
+					ctx.source,
+					popen.line,
+					popen.col
 				);
-				pushed_state = true;
 			}
 
-			instructions.append(
-				instruction(rs_instruction::move).arg(rs_register::this_obj).arg(rs_register::lvalue),
-				ctx.file,
-				accessor_operator.line,
-				accessor_operator.col,
-				t.lines[accessor_operator.line]
-			);
+			compile_expression(arg, ctx, instructions, param);
 
-			auto num = t.number_constant(false);
-			if (num.valid()) {
-				variable_id vid = define_static_string(m_script_context, num.text);
-				auto i = instruction(rs_instruction::prop).arg(rs_register::lvalue).arg(vid);
+			if (saved == rs_register::null_register) {
+				const token& end = arg->tok.valid() ? arg->tok : node->close;
 				instructions.append(
-					i,
-					ctx.file,
-					num.line,
-					num.col,
-					t.lines[num.line]
+					instruction(rs_instruction::popState).arg(param),
+					ctx.source,
+					end.line,
+					end.col
 				);
-				t.character(']');
-			} else {
-				auto str = t.string_constant(false, true, false);
-				if (str.valid()) {
-					variable_id vid = define_static_string(m_script_context, str.text);
-
-					instructions.append(
-						instruction(rs_instruction::prop).arg(rs_register::lvalue).arg(vid),
-						ctx.file,
-						str.line,
-						str.col,
-						t.lines[str.line]
-					);
-					t.character(']');
-				} else {
-					instructions.append(
-						instruction(rs_instruction::pushState),
-						ctx.file,
-						index_open_operator.line,
-						index_open_operator.col,
-						t.lines[index_open_operator.line]
-					);
-
-					compile_expression(t, ctx, instructions, true);
-
-					t.character(']');
-
-					instructions.append(
-						instruction(rs_instruction::popState).arg(rs_register::rvalue),
-						ctx.file,
-						index_open_operator.line,
-						index_open_operator.col,
-						t.lines[index_open_operator.line]
-					);
-
-					instruction& prop = instructions.append(
-						instruction(rs_instruction::prop).arg(rs_register::lvalue).arg(rs_register::rvalue),
-						ctx.file,
-						index_open_operator.line,
-						index_open_operator.col,
-						t.lines[index_open_operator.line]
-					);
-
-					t.backup_state();
-					token assignment = t.keyword(false, "=");
-					t.restore_state();
-
-					if (assignment.valid()) {
-						// this property on the object is being assigned
-						prop.code = rs_instruction::propAssign;
-					}
-				}
 			}
-
-			return false;
 		}
 
-		return variable.is_const;
+		// the caller uses the callee's register right after this, before anything
+		// else can be allocated
+		ctx.scratch_count = outer_scratch_count;
 	}
 
-	bool script_compiler::compile_parameter_list(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected) {
-		if (!expected) {
-			t.backup_state();
-			instructions.backup();
-		}
-
-		token popen = t.character('(', expected);
-		if (!popen.valid()) {
-			t.restore_state();
-			instructions.restore();
-			return false;
-		}
-
-		instructions.append(
-			instruction(rs_instruction::pushState),
-			ctx.file,
-			popen.line,
-			popen.col,
-			t.lines[popen.line]
-		);
-
-		instructions.append(
-			instruction(rs_instruction::clearParams),
-			ctx.file,
-			popen.line,
-			popen.col,
-			t.lines[popen.line]
-		);
-
-		token pclose;
-		token comma;
-		for (u16 p = 0;p < 128;p++) {
-			if (p >= 8) {
-				throw parse_exception(
-					"Functions can only have up to 8 parameters",
-					ctx.file,
-					t.lines[comma.line],
-					comma.line,
-					comma.col
-				);
+	void script_compiler::compile_json(ast_node* node, rs_register destination, parse_context& ctx, instruction_array& instructions) {
+		const token& obj_open = node->open;
+		const token& obj_close = node->close;
+
+		// the object is kept in a scratch register while the property values are
+		// compiled. they overwrite lvalue, which holds the left side of an operator
+		// when the object is the right side
+		rs_register obj = ctx.alloc_scratch();
+		rs_register saved = rs_register::null_register;
+		if (obj != rs_register::null_register && destination != rs_register::lvalue) {
+			saved = ctx.alloc_scratch();
+			if (saved == rs_register::null_register) {
+				ctx.free_scratch(obj);
+				obj = rs_register::null_register;
 			}
+		}
+		bool in_state = obj == rs_register::null_register;
 
-			pclose = t.character(')', !comma.valid() && p > 0);
-			if (pclose.valid()) break;
-
+		if (in_state) {
 			instructions.append(
 				instruction(rs_instruction::pushState),
-				ctx.file,
-				popen.line,
-				popen.col,
-				t.lines[popen.line]
+				ctx.source,
+				obj_open.line,
+				obj_open.col
 			);
-
-			compile_expression(t, ctx, instructions, true, rs_register(rs_register::parameter0 + p));
-			comma = t.character(',', false);
-
+		} else if (saved != rs_register::null_register) {
 			instructions.append(
-				instruction(rs_instruction::popState).arg(rs_register(rs_register::parameter0 + p)),
-				ctx.file,
-				(comma.valid() ? comma : pclose).line,
-				(comma.valid() ? comma : pclose).col,
-				t.lines[(comma.valid() ? comma : pclose).line]
+				instruction(rs_instruction::move).arg(saved).arg(rs_register::lvalue),
+				ctx.source,
+				obj_open.line,
+				obj_open.col
 			);
 		}
 
-		if (!expected) {
-			t.commit_state();
-			instructions.commit();
-		}
-		return true;
-	}
-
-	bool script_compiler::compile_json(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected) {
-		t.backup_state();
-		token obj_open = t.character('{', expected);
-		if (!obj_open.valid()) return false;
-
 		instructions.append(
-			instruction(rs_instruction::pushState),
-			ctx.file,
-			obj_open.line,
-			obj_open.col,
-			t.lines[obj_open.line]
-		);
-
-		instructions.append(
-			instruction(rs_instruction::newObj),
-			ctx.file,
+			in_state ? instruction(rs_instruction::newObj) : instruction(rs_instruction::newObj).arg(obj),
+			ctx.source,
 			obj_open.line,
-			obj_open.col,
-			t.lines[obj_open.line]
+			obj_open.col
 		);
 
-		token obj_close = t.character('}', false);
-		bool maybe_not_json = !expected;
-		while (!t.at_end() && !obj_close.valid()) {
-			token propName = t.identifier(false);
-			if (!propName.valid()) propName = t.number_constant(false);
-			if (!propName.valid()) propName = t.string_constant(!maybe_not_json, true, false);
-			if (!propName.valid()) {
-				// can only happen if this isn't a JSON object
-				t.restore_state();
-				return false;
-			}
-
+		for (ast_node* prop : node->children) {
+			const token& propName = prop->tok;
+			const token& assign = prop->open;
 			variable_id prop_name_id = define_static_string(m_script_context, propName.text);
 
-			token assign = t.character(':', !maybe_not_json);
-			if (!assign.valid()) {
-				// can only happen if this isn't a JSON object
-				t.restore_state();
-				return false;
+			if (in_state) {
+				instructions.append(
+					instruction(rs_instruction::pushState),
+					ctx.source,
+					assign.line,
+					assign.col
+				);
 			}
 
-			instructions.append(
-				instruction(rs_instruction::pushState),
-				ctx.file,
-				assign.line,
-				assign.col,
-				t.lines[assign.line]
-			);
+			compile_expression(prop->children[0], ctx, instructions);
 
-			compile_expression(t, ctx, instructions, true);
+			if (in_state) {
+				instructions.append(
+					instruction(rs_instruction::popState).arg(rs_register::rvalue),
+					ctx.source,
+					assign.line,
+					assign.col
+				);
 
-			instructions.append(
-				instruction(rs_instruction::popState).arg(rs_register::rvalue),
-				ctx.file,
-				assign.line,
-				assign.col,
-				t.lines[assign.line]
-			);
+				instructions.append(
+					instruction(rs_instruction::pushState),
+					ctx.source,
+					assign.line,
+					assign.col
+				);
+			} else {
+				instructions.append(
+					instruction(rs_instruction::move).arg(rs_register::lvalue).arg(obj),
+					ctx.source,
+					assign.line,
+					assign.col
+				);
+			}
 
 			instructions.append(
-				instruction(rs_instruction::pushState),
-				ctx.file,
-				assign.line,
-				assign.col,
-				t.lines[assign.line]
-			);
-			instructions.append(
-				instruction(rs_instruction::propAssign).arg(rs_register::lvalue).arg(prop_name_id),
-				ctx.file,
+				instruction(rs_instruction::propAssign).arg(rs_register::lvalue).arg(prop_name_id).imm(instructions.add_property_cache(m_script_context->atoms->get(propName.text))),
+				ctx.source,
 				assign.line,
-				assign.col,
-				t.lines[assign.line]
+				assign.col
 			);
 			instructions.append(
 				instruction(rs_instruction::store).arg(rs_register::lvalue).arg(rs_register::rvalue),
-				ctx.file,
+				ctx.source,
 				assign.line,
-				assign.col,
-				t.lines[assign.line]
-			);
-			instructions.append(
-				instruction(rs_instruction::popState),
-				ctx.file,
-				assign.line,
-				assign.col,
-				t.lines[assign.line]
+				assign.col
 			);
 
-			obj_close = t.character('}', false);
+			if (in_state) {
+				instructions.append(
+					instruction(rs_instruction::popState),
+					ctx.source,
+					assign.line,
+					assign.col
+				);
+			}
 		}
 
-		if (!obj_close.valid()) {
-			throw parse_exception(
-				"Encountered unexpected end of input while parsing object body",
-				ctx.file,
-				t.lines[obj_open.line],
-				obj_open.line,
-				obj_open.col
-			);
-		}
+		if (in_state) {
+			if (destination != rs_register::lvalue) {
+				instructions.append(
+					instruction(rs_instruction::move).arg(destination).arg(rs_register::lvalue),
+					ctx.source,
+					obj_close.line,
+					obj_close.col
+				);
+			}
 
-		if (destination != rs_register::lvalue) {
 			instructions.append(
-				instruction(rs_instruction::move).arg(destination).arg(rs_register::lvalue),
-				ctx.file,
+				instruction(rs_instruction::popState).arg(destination),
+				ctx.source,
 				obj_close.line,
-				obj_close.col,
-				t.lines[obj_close.line]
+				obj_close.col
+			);
+		} else {
+			instructions.append(
+				instruction(rs_instruction::move).arg(destination).arg(obj),
+				ctx.source,
+				obj_close.line,
+				obj_close.col
 			);
-		}
 
-		instructions.append(
-			instruction(rs_instruction::popState).arg(destination),
-			ctx.file,
-			obj_close.line,
-			obj_close.col,
-			t.lines[obj_close.line]
-		);
+			if (saved != rs_register::null_register) {
+				instructions.append(
+					instruction(rs_instruction::move).arg(rs_register::lvalue).arg(saved),
+					ctx.source,
+					obj_close.line,
+					obj_close.col
+				);
+			}
+		}
 
-		t.commit_state();
-		return true;
+		ctx.free_scratch(saved);
+		ctx.free_scratch(obj);
 	}
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <defs.h>
 #include <instruction_array.h>
 #include <parse_utils.h>
+#include <ast.h>
+#include <passes.h>
 
 #include <string>
 #include <stack>
@@ -9,6 +11,10 @@
 namespace rs {
 	class variable;
 	class object_prototype;
+
+	// returns a static variable holding the number in 'tok'
+	variable_id define_static_number(context* ctx, const tokenizer::token& tok);
+
 	class script_compiler {
 		public:
 			script_compiler(const context_parameters& params);
@@ -42,6 +48,9 @@ namespace rs {
 
 			struct parse_context {
 				std::string file;
+				// id of the code in the instruction array's source map
+				u32 source;
+				tokenizer* tokens;
 				ref_vec globals;
 				std::vector<ref_vec> locals;
 				std::vector<object_prototype*> prototypes;
@@ -53,29 +62,73 @@ namespace rs {
 				function_ref* currentFunction;
 				object_prototype* currentPrototype;
 				bool constructingPrototype;
+				// number of scratch registers in use, they're allocated and freed in
+				// stack order
+				u8 scratch_count;
+
+				// declarations by name, so that looking a name up doesn't depend on
+				// how many things were declared before it. each local name maps to
+				// where it's declared in 'locals', innermost scope last
+				struct local_location {
+					u32 scope;
+					u32 index;
+				};
+				munordered_map<std::string, std::vector<local_location>> local_names;
+				munordered_map<std::string, function_ref*> function_names;
+				munordered_map<std::string, object_prototype*> prototype_names;
+				// what the context had when compiling started. values are indices
+				// into ctx->global_variables, global_functions and prototypes
+				munordered_map<std::string, u32> context_variable_names;
+				munordered_map<std::string, u32> context_function_names;
+				munordered_map<std::string, u32> context_prototype_names;
+
+				void index_context();
+				// adds a local to the innermost scope
+				void declare(const var_ref& ref);
+				void declare(function_ref* func);
+				void declare(object_prototype* proto);
 
 				void push_locals();
 				void pop_locals();
 				var_ref var(const std::string& name);
 				variable_id func(const std::string& name);
 				object_prototype* proto(const std::string& name);
+
+				// returns null_register when all of them are in use
+				rs_register alloc_scratch();
+				void free_scratch(rs_register reg);
 			};
 
 			bool compile(const std::string& code, instruction_array& instructions);
 			
 		protected:
 			context* m_script_context;
-			void initialize_tokenizer(tokenizer& t);
-			void check_declaration(tokenizer& t, parse_context& ctx, tokenizer::token& declaration);
-			function_ref* compile_function(tokenizer& t, parse_context& ctx, instruction_array& instructions, rs_register destination = rs_register::lvalue, bool allow_name = true);
-			object_prototype* compile_class(tokenizer& t, parse_context& ctx, instruction_array& instructions);
-			bool compile_expression(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected, rs_register destination = rs_register::rvalue, bool compile_lhs = true);
-			bool compile_expression_value(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected, bool& value_is_const);
-			bool compile_accessor_chain(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool is_nested);
-			bool compile_statement(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool parseSemicolon = true);
-			bool compile_identifier(const var_ref& variable, const tokenizer::token& reference, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool& pushed_state);
-			bool compile_parameter_list(tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected);
-			bool compile_json(rs_register destination, tokenizer& t, parse_context& ctx, instruction_array& instructions, bool expected);
+			pass_manager m_passes;
+			// static true and false, created the first time they're used
+			variable_id m_true;
+			variable_id m_false;
+			variable_id static_bool(bool value);
+			void check_declaration(parse_context& ctx, const tokenizer::token& declaration);
+			function_ref* compile_function(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination = rs_register::lvalue);
+			object_prototype* compile_class(ast_node* node, parse_context& ctx, instruction_array& instructions);
+			void compile_expression(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination = rs_register::rvalue);
+			// 'result_constant' is set to the number that the operator results in,
+			// when that's known
+			void compile_operator(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination, bool lhs_is_const, variable_id& result_constant);
+			// || and &&, which only evaluate their right side when the left side
+			// doesn't decide the result
+			void compile_logical_operator(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register destination);
+			// returns whether the value can't be assigned to
+			bool compile_expression_value(ast_node* node, rs_register destination, parse_context& ctx, instruction_array& instructions);
+			// compiles the accessors of an nt_access node from 'idx' on
+			bool compile_accessor_chain(ast_node* node, size_t idx, rs_register destination, parse_context& ctx, instruction_array& instructions, bool is_nested);
+			void compile_statement(ast_node* node, parse_context& ctx, instruction_array& instructions);
+			// compiles the statements of an nt_block, or the statement of an nt_body
+			void compile_body(ast_node* node, parse_context& ctx, instruction_array& instructions);
+			// 'callee' is the register that holds the function being called. it's
+			// changed if the arguments would overwrite that register
+			void compile_parameter_list(ast_node* node, parse_context& ctx, instruction_array& instructions, rs_register& callee);
+			void compile_json(ast_node* node, rs_register destination, parse_context& ctx, instruction_array& instructions);
 	};
 };
 
@@ -3,14 +3,43 @@
 #include <execution_state.h>
 #include <script_object.h>
 #include <script_function.h>
+#include <module.h>
+#include <program.h>
+#include <prototype.h>
 using namespace std;
 
 namespace rs {
+	static void print_exception(const runtime_exception& e) {
+		if (e.has_source_info) {
+			printf("%s:%d:%d: %s\n%s\n", e.file.c_str(), e.line + 1, e.col + 1, e.text.c_str(), e.lineText.c_str());
+			for (i64 c = 0;c < i64(e.col);c++) printf(" ");
+			printf("^\n");
+		} else printf("%s\n", e.text.c_str());
+	}
+
+	// the variable that holds 'ret' may be released or reused once the call returns,
+	// so its value is copied unless it's a pointer to something that outlives it
+	static void copy_result(const context_memory::mem_var& ret, context_memory::mem_var& result) {
+		if (!ret.size) return;
+		result.type = ret.type;
+		result.size = ret.size;
+		if (type_is_ptr(ret.type) && ret.type != rs_builtin_type::t_string) result.data = ret.data;
+		else {
+			result.data = new u8[ret.size];
+			memcpy(result.data, ret.data, ret.size);
+		}
+	}
+
 	context::context(context_parameters& params) {
 		params.ctx = this;
 		instructions = new instruction_array(params);
 		compiler = new script_compiler(params);
 		memory = new context_memory(params);
+		gc = new garbage_collector(params);
+		atoms = new atom_table(params);
+		root_shape = new object_shape(nullptr);
+		memset(m_type_specific, 0, sizeof(m_type_specific));
+		m_next_type_id = rs_builtin_type::script_type_base + 1;
 
 		add_default_instruction_set(this);
 		add_number_instruction_set(this);
@@ -21,119 +50,157 @@ namespace rs {
 	}
 
 	context::~context() {
+		for (size_t i = 0;i < m_idle_states.size();i++) delete *m_idle_states[i];
 		delete instructions;
 		delete compiler;
+		delete gc;
+		delete root_shape;
+		delete atoms;
 		delete memory;
 	}
 
 	bool context::add_code(const string& code) {
 		integer_type entry = instructions->count();
+		declarations d = declared();
 		instructions->backup();
 
 		if (compiler->compile(code, *instructions)) {
+			execution_state* es = acquire_state();
 			try {
-				execution_state es(m_params, this);
-				es.execute(entry);
+				es->execute(entry);
+				release_state(es);
 				instructions->commit();
 				return true;
 			} catch (const runtime_exception& e) {
-				if (e.has_source_info) {
-					printf("%s:%d:%d: %s\n%s\n", e.file.c_str(), e.line + 1, e.col + 1, e.text.c_str(), e.lineText.c_str());
-					for (i64 c = 0;c < i64(e.col);c++) printf(" ");
-					printf("^\n");
-				} else printf("%s\n", e.text.c_str());
+				release_state(es);
+				print_exception(e);
 			}
 		}
 
+		undeclare(d);
 		instructions->restore();
 		return false;
 	}
 
+	bool context::save_module(const string& path) {
+		return write_module(this, path, false);
+	}
+
+	bool context::load_module(const string& path) {
+		vector<u8> data;
+		module_image image;
+		if (!read_module_file(path, data) || !read_module_image(data, path, image)) return false;
+		return load_module(image, false, false);
+	}
+
+	bool context::load_module(const module_image& image, bool heap, bool shared) {
+		integer_type entry = instructions->count();
+		declarations d = declared();
+		instructions->backup();
+
+		if (load_module_image(this, image, heap, shared)) {
+			if (heap) {
+				instructions->commit();
+				return true;
+			}
+
+			execution_state* es = acquire_state();
+			try {
+				es->execute(entry);
+				release_state(es);
+				instructions->commit();
+				return true;
+			} catch (const runtime_exception& e) {
+				release_state(es);
+				print_exception(e);
+			}
+		}
+
+		undeclare(d);
+		instructions->restore();
+		return false;
+	}
+
+	bool context::save_snapshot(const string& path) {
+		return write_module(this, path, true);
+	}
+
+	bool context::load_snapshot(const string& path) {
+		vector<u8> data;
+		module_image image;
+		if (!read_module_file(path, data) || !read_module_image(data, path, image)) return false;
+		return load_module(image, true, false);
+	}
+
+	bool context::load_program(const program& prog) {
+		if (!prog.valid()) return false;
+		return load_module(prog.image(), prog.has_heap(), true);
+	}
+
 	bool context::execute(const string& code, context_memory::mem_var& result) {
 		integer_type entry = instructions->count();
+		declarations d = declared();
+		instructions->backup();
+
 		if (compiler->compile(code, *instructions)) {
+			execution_state* es = acquire_state();
 			try {
-				execution_state es(m_params, this);
-				es.execute(entry);
-				variable_id ret_id = es.registers()[rs_register::rvalue];
-				auto& ret = memory->get(ret_id);
-				if (ret.size) {
-					result.type = ret.type;
-					result.size = ret.size;
-					if (type_is_ptr(ret.type)) result.data = ret.data;
-					else {
-						result.data = new u8[ret.size];
-						memcpy(result.data, ret.data, ret.size);
-					}
-				}
+				es->execute(entry);
+				variable_id ret_id = es->registers()[rs_register::rvalue];
+				copy_result(memory->get(ret_id), result);
+				release_state(es);
+				instructions->commit();
 				return true;
 			} catch (const runtime_exception& e) {
-				if (e.has_source_info) {
-					printf("%s:%d:%d: %s\n%s\n", e.file.c_str(), e.line + 1, e.col + 1, e.text.c_str(), e.lineText.c_str());
-					for (i64 c = 0;c < i64(e.col);c++) printf(" ");
-					printf("^\n");
-				} else printf("%s\n", e.text.c_str());
-				memset(&result, 0, sizeof(context_memory::mem_var));
+				release_state(es);
+				print_exception(e);
 			}
 		}
+
+		memset(&result, 0, sizeof(context_memory::mem_var));
+		undeclare(d);
+		instructions->restore();
 		return false;
 	}
 
 	bool context::call_function(script_function* func, variable_id this_obj, variable_id* args, u8 arg_count, context_memory::mem_var& result) {
 		if (func->cpp_callback) {
-			func_args cb_args;
-			cb_args.context = this;
-			cb_args.self = this_obj == 0 ? nullptr : (script_object*)memory->get(this_obj).data;
-			cb_args.state = nullptr;
-
-			for (u8 i = 0;i < arg_count;i++) {
-				cb_args.parameters.push({
-					memory->get(args[i]),
-					args[i]
-				});
-			}
+			func_args cb_args = {
+				this_obj == 0 ? nullptr : (script_object*)memory->get(this_obj).data,
+				this,
+				nullptr,
+				func,
+				func_args::arg_span(memory, args, arg_count)
+			};
 
-			variable_id ret_id = func->cpp_callback(&cb_args);
-			auto& ret = memory->get(ret_id);
-			if (ret.size) {
-				result.type = ret.type;
-				result.size = ret.size;
-				if (type_is_ptr(ret.type)) result.data = ret.data;
-				else {
-					result.data = new u8[ret.size];
-					memcpy(result.data, ret.data, ret.size);
-				}
-			}
+			try {
+				variable_id ret_id = func->cpp_callback(&cb_args);
+				copy_result(memory->get(ret_id), result);
 
-			return true;
+				return true;
+			} catch (const runtime_exception& e) {
+				// typed bindings throw when their arguments can't be converted
+				printf("%s\n", e.text.c_str());
+				memset(&result, 0, sizeof(context_memory::mem_var));
+			}
 		} else {
+			execution_state* es = acquire_state();
 			try {
-				execution_state es(m_params, this);
-				es.push_state();
-				register_type* registers = es.registers();
+				es->push_state();
+				es->push_scope();
+				register_type* registers = es->registers();
 				for (u8 i = 0;i < arg_count;i++) {
 					registers[rs_register::parameter0 + i] = args[i];
 				}
 				registers[rs_register::this_obj] = this_obj;
-				es.execute(func->entry_point, func->exit_point);
-				variable_id ret_id = es.registers()[rs_register::return_value];
-				auto& ret = memory->get(ret_id);
-				if (ret.size) {
-					result.type = ret.type;
-					result.size = ret.size;
-					if (type_is_ptr(ret.type)) result.data = ret.data;
-					else {
-						result.data = new u8[ret.size];
-						memcpy(result.data, ret.data, ret.size);
-					}
-				}
+				es->execute(func->entry_point, func->exit_point);
+				variable_id ret_id = es->registers()[rs_register::return_value];
+				copy_result(memory->get(ret_id), result);
+				release_state(es);
 				return true;
 			} catch (const runtime_exception& e) {
-				if (e.has_source_info) {
-					printf("%s:%d:%d: %s\n%s\n", e.file.c_str(), e.line + 1, e.col + 1, e.text.c_str(), e.lineText.c_str());
-					for (i64 c = 0;c < i64(e.col);c++) printf(" ");
-					printf("^\n");
-				} else printf("%s\n", e.text.c_str());
+				release_state(es);
+				print_exception(e);
 				memset(&result, 0, sizeof(context_memory::mem_var));
 			}
 		}
@@ -141,6 +208,43 @@ namespace rs {
 		return false;
 	}
 
+	void context::release_result(context_memory::mem_var& result) {
+		if (result.data && (!type_is_ptr(result.type) || result.type == rs_builtin_type::t_string)) delete [] (u8*)result.data;
+		memset(&result, 0, sizeof(context_memory::mem_var));
+	}
+
+	void context::undeclare(const declarations& d) {
+		for (size_t f = d.function_count;f < global_functions.size();f++) {
+			memory->set(global_functions[f]->function_id, rs_builtin_type::t_null, 0, nullptr);
+		}
+		for (size_t p = d.prototype_count;p < prototypes.size();p++) {
+			memory->set(prototypes[p]->id(), rs_builtin_type::t_null, 0, nullptr);
+		}
+
+		global_functions.resize(d.function_count);
+		prototypes.resize(d.prototype_count);
+		global_variables.resize(d.global_count);
+	}
+
+	execution_state* context::acquire_state() {
+		if (m_idle_states.size() == 0) return new execution_state(m_params, this);
+
+		size_t last = m_idle_states.size() - 1;
+		execution_state* state = *m_idle_states[last];
+		m_idle_states.remove(last);
+		gc->add_state(state);
+		return state;
+	}
+
+	void context::release_state(execution_state* state) {
+		state->reset();
+
+		// the collector only runs when a single state is executing, idle ones
+		// must not count
+		gc->remove_state(state);
+		m_idle_states.push(state);
+	}
+
 	void context::define_instruction(type_id type, rs_instruction instruction, instruction_callback cb) {
 		while (m_instruction_sets.size() <= type) {
 			instruction_set set;
@@ -149,6 +253,7 @@ namespace rs {
 		}
 
 		m_instruction_sets[type]->callbacks[instruction] = cb;
+		if (type != 0) m_type_specific[instruction] = true;
 	}
 
 	void context::bind_function(const string& name, script_function_callback cb) {
@@ -2,11 +2,16 @@
 #include <compiler.h>
 #include <dynamic_array.hpp>
 #include <context_memory.h>
+#include <garbage_collector.h>
+#include <atom_table.h>
 
 namespace rs {
 	class execution_state;
 	class script_function;
 	class object_prototype;
+	class object_shape;
+	class program;
+	struct module_image;
 
 	typedef void (*instruction_callback)(execution_state*, instruction_array::instruction*);
 
@@ -23,31 +28,94 @@ namespace rs {
 			~context();
 
 			bool add_code(const std::string& code);
+			// writes everything that was compiled so far to a module (see module.h),
+			// so it can be loaded later without compiling it again
+			bool save_module(const std::string& path);
+			// loads a module and runs its top level code, the same way add_code
+			// runs the code that it compiles
+			bool load_module(const std::string& path);
+			// writes a module along with the values of its variables and the objects
+			// they refer to, so a context can be restored without running its code
+			bool save_snapshot(const std::string& path);
+			// loads a snapshot into this context, the top level code isn't run again
+			bool load_snapshot(const std::string& path);
+			// loads a program that other contexts may be loading at the same time. if
+			// it was created with its heap it's loaded like a snapshot, otherwise its
+			// top level code is run like a module's
+			bool load_program(const program& prog);
+			// the value that 'result' is given is a copy owned by the caller, unless it's
+			// an object, function or class, which stay owned by this context. either way
+			// it must be passed to release_result once the caller is done with it
 			bool execute(const std::string& code, context_memory::mem_var& result);
 			bool call_function(script_function* func, variable_id this_obj, variable_id* args, u8 arg_count, context_memory::mem_var& result);
+			void release_result(context_memory::mem_var& result);
+			// execution states are kept after they're used rather than being rebuilt
+			// for every call. a state that was acquired must be released, after which
+			// it's reset and given to the next caller
+			execution_state* acquire_state();
+			void release_state(execution_state* state);
 			const context_parameters& params() const { return m_params; }
 
 			struct instruction_set {
 				instruction_callback callbacks[rs_instruction::instruction_count];
 			};
 			void define_instruction(type_id type, rs_instruction instruction, instruction_callback cb);
+
+			// whether any type other than the default defines 'instruction'
+			inline bool is_type_specific(rs_instruction instruction) const { return m_type_specific[instruction]; }
 			inline const instruction_set* get_instruction_set(type_id type) {
 				if (m_instruction_sets.size() > type) return m_instruction_sets[type];
 				return m_instruction_sets[0];
 			}
 
 			void bind_function(const std::string& name, script_function_callback cb);
+			// binds a c++ function that takes and returns numbers, bools, strings or
+			// objects, such as bind_function<integer_type(decimal_type, std::string_view)>.
+			// the code that converts and checks its arguments is generated for its
+			// signature. it's defined in script_function.h, which must be included
+			// wherever this is called
+			template <typename Sig>
+			void bind_function(const std::string& name, Sig* fn);
+			// type ids of prototypes, unique within this context
+			inline type_id gen_type_id() { return m_next_type_id++; }
 
 			instruction_array* instructions;
 			script_compiler* compiler;
 			context_memory* memory;
+			garbage_collector* gc;
+			atom_table* atoms;
+			// shape of objects that have no prototype and no properties
+			object_shape* root_shape;
 
 			std::vector<script_function*> global_functions;
 			std::vector<variable> global_variables;
 			std::vector<object_prototype*> prototypes;
 
+			// how much of global_functions, prototypes and global_variables has been
+			// declared. what code that fails to compile, load or run declared is taken
+			// out again with undeclare
+			struct declarations {
+				size_t function_count;
+				size_t prototype_count;
+				size_t global_count;
+			};
+			inline declarations declared() const { return { global_functions.size(), prototypes.size(), global_variables.size() }; }
+			// removes what was declared after 'd', so that its names can be declared
+			// again. the variables holding its functions and classes are emptied, but
+			// the functions and prototypes aren't deleted because values that were
+			// created by code that already ran may still refer to them
+			void undeclare(const declarations& d);
+
 		protected:
+			// 'heap' loads the module as a snapshot, without running it. see
+			// load_module_image for 'shared'
+			bool load_module(const module_image& image, bool heap, bool shared);
+
 			dynamic_pod_array<instruction_set> m_instruction_sets;
+			bool m_type_specific[rs_instruction::instruction_count];
 			context_parameters m_params;
+			type_id m_next_type_id;
+			// states that were released and aren't executing anything
+			dynamic_pod_array<execution_state*> m_idle_states;
 	};
 };
\ No newline at end of file
@@ -4,114 +4,153 @@
 #include <parse_utils.h>
 
 namespace rs {
-	context_memory::mem_var context_memory::null = { nullptr, 0, 0, true };
-	variable_id context_memory::next_var_id = 1;
-
 	context_memory::context_memory(const context_parameters& params) {
 		m_max_memory = params.memory.max_size;
+		m_pages = nullptr;
+		m_page_count = 0;
+		m_allocated = 0;
+		m_high_water_mark = 0;
+		m_next_var_id = 1;
 	}
 
 	context_memory::~context_memory() {
-		for (auto& v : m_vars) {
-			if (v.second.data && !v.second.external) {
-				if (type_is_ptr(v.second.type)) delete v.second.data;
-				else delete [] v.second.data;
+		// objects are owned by the garbage collector
+		for (u64 p = 0;p < m_page_count;p++) {
+			if (!m_pages[p]) continue;
+			for (u64 i = 0;i < page_size;i++) {
+				slot& s = m_pages[p][i];
+				if (s.flags & sf_allocated) free_string(&s);
 			}
+			delete [] m_pages[p];
 		}
-		m_vars.clear();
 
-		for (auto& v : m_static_vars) {
-			if (v.second.data && !v.second.external) {
-				if (type_is_ptr(v.second.type)) delete v.second.data;
-				else delete [] v.second.data;
+		if (m_pages) delete [] m_pages;
+		m_pages = nullptr;
+		m_page_count = 0;
+	}
+
+	context_memory::slot* context_memory::alloc(variable_id id) {
+		u64 page = id >> page_shift;
+		if (page >= m_page_count) {
+			u64 count = m_page_count ? m_page_count : 1;
+			while (count <= page) count *= 2;
+
+			slot** pages = new slot*[count];
+			memset(pages, 0, count * sizeof(slot*));
+			if (m_pages) {
+				memcpy(pages, m_pages, m_page_count * sizeof(slot*));
+				delete [] m_pages;
 			}
+			m_pages = pages;
+			m_page_count = count;
 		}
-		m_static_vars.clear();
+
+		if (!m_pages[page]) {
+			m_pages[page] = new slot[page_size];
+			memset(m_pages[page], 0, page_size * sizeof(slot));
+		}
+
+		return m_pages[page] + (id & page_mask);
 	}
 
 	void context_memory::set(variable_id id, type_id type, size_t size, void* data) {
-		if (m_vars.count(id) == 0) {
-			u8* d = nullptr;
-			if (type_is_ptr(type)) d = (u8*)data;
+		// most variables that are set already exist
+		slot* s = at(id);
+		if (!s) {
+			s = alloc(id);
+			s->flags = sf_allocated;
+			if (++m_allocated > m_high_water_mark) m_high_water_mark = m_allocated;
+		}
+
+		if (s->type == rs_builtin_type::t_string && s->ptr != data) free_string(s);
+
+		if (type_is_ptr(type)) s->ptr = data;
+		else if (size > 0) {
+			// injected members are written through to the c++ object
+			if ((s->flags & sf_external) && !type_is_ptr(s->type)) memmove(s->ptr, data, size);
 			else {
-				d = new u8[max_variable_size];
-				if (size > 0) memcpy(d, data, size);
+				s->flags &= ~sf_external;
+				memmove(s->bytes, data, size);
+				if (size < sizeof(s->bytes)) memset(s->bytes + size, 0, sizeof(s->bytes) - size);
 			}
-			m_vars[id] = { d, size, type, false };
-		} else {
-			auto& v = m_vars[id];
-
-			if (type_is_ptr(type)) {
-				if (type_is_ptr(v.type)) {
-					if (v.type == rs_builtin_type::t_string) delete [] *(char**)v.data;
-					v.data = (u8*)data;
-				}
-				else {
-					delete [] v.data;
-					v.data = (u8*)data;
-				}
-			} else {
-				if (type_is_ptr(v.type)) v.data = new u8[max_variable_size];
-				if (size > 0) memcpy(v.data, data, size);
-			}
-
-			v.size = size;
-			v.type = type;
 		}
+
+		s->size = u32(size);
+		s->type = type;
 	}
 
 	variable_id context_memory::set(type_id type, size_t size, void* data) {
-		u8* d = nullptr;
-		if (type_is_ptr(type)) d = (u8*)data;
-		else {
-			d = new u8[max_variable_size];
-			if (size > 0) memcpy(d, data, size);
+		variable_id id = 0;
+		while (!id && m_free_ids.size() > 0) {
+			size_t last = m_free_ids.size() - 1;
+			variable_id free_id = *m_free_ids[last];
+			m_free_ids.remove(last);
+			if (!at(free_id)) id = free_id;
 		}
-		variable_id id = gen_var_id();
-		m_vars[id] = { d, size, type, false };
+
+		if (!id) id = gen_var_id();
+		set(id, type, size, data);
 		return id;
 	}
 
 	variable_id context_memory::set_static(type_id type, size_t size, void* data) {
-		u8* d = nullptr;
-		if (type_is_ptr(type)) d = (u8*)data;
-		else {
-			d = new u8[max_variable_size];
-			if (size > 0) memcpy(d, data, size);
-		}
-
 		variable_id id = gen_var_id();
-		mem_var v = { d, size, type, true };
-		m_static_vars[id] = v;
+		set(id, type, size, data);
+		at(id)->flags |= sf_static;
 		return id;
 	}
 
 	variable_id context_memory::inject(type_id type, size_t size, void* ptr) {
 		variable_id id = gen_var_id();
-		mem_var v = { ptr, size, type, true };
-		m_vars[id] = v;
+		slot* s = alloc(id);
+		s->flags = sf_allocated | sf_external;
+		if (++m_allocated > m_high_water_mark) m_high_water_mark = m_allocated;
+		s->type = type;
+		s->size = u32(size);
+		s->ptr = ptr;
 		return id;
 	}
 
-	context_memory::mem_var& context_memory::get(variable_id id) {
-		if (m_vars.count(id) != 0) return m_vars[id];
-		if (m_static_vars.count(id) != 0) return m_static_vars[id];
+	void context_memory::copy(variable_id id, const mem_var& value) {
+		if (value.type != rs_builtin_type::t_string) {
+			set(id, value.type, value.size, value.data);
+			return;
+		}
+
+		char* str = new char[value.size];
+		memcpy(str, value.data, value.size);
+		set(id, value.type, value.size, str);
+	}
+
+	variable_id context_memory::copy(const mem_var& value) {
+		if (value.type != rs_builtin_type::t_string) return set(value.type, value.size, value.data);
 
-		return null;
+		char* str = new char[value.size];
+		memcpy(str, value.data, value.size);
+		return set(value.type, value.size, str);
 	}
 
-	void context_memory::deallocate(variable_id id) {
-		if (m_vars.count(id) == 0) {
+	void context_memory::deallocate(variable_id id, bool recycle_id) {
+		slot* s = at(id);
+		if (!s || (s->flags & sf_static)) {
 			throw runtime_exception(format("Variable %llu doesn't exist", id));
-		} else {
-			auto& v = m_vars[id];
-			if (v.data) delete [] v.data;
-			m_vars.erase(id);
 		}
+
+		free_string(s);
+		memset(s, 0, sizeof(slot));
+		m_allocated--;
+
+		if (recycle_id) m_free_ids.push(id);
+	}
+
+	void context_memory::free_string(slot* s) {
+		if (s->type != rs_builtin_type::t_string || (s->flags & sf_external) || !s->ptr) return;
+		delete [] (char*)s->ptr;
+		s->ptr = nullptr;
 	}
 
 
-	std::string var_tostring(rs::context_memory::mem_var& v) {
+	std::string var_tostring(const rs::context_memory::mem_var& v) {
 		std::string val;
 		if (!v.data) val = "undefined";
 		else {
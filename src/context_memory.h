@@ -1,5 +1,6 @@
 #pragma once
 #include <defs.h>
+#include <dynamic_array.hpp>
 
 namespace rs {
 	class context_memory {
@@ -7,8 +8,40 @@ namespace rs {
 			context_memory(const context_parameters& params);
 			~context_memory();
 
-			static variable_id gen_var_id() { return next_var_id++; }
+			// ids are only unique within one context, contexts share nothing
+			inline variable_id gen_var_id() { return m_next_var_id++; }
 
+			enum slot_flags {
+				sf_allocated	= 1,
+				// data lives outside of the slot (injected c++ members)
+				sf_external		= 2,
+				// created with set_static, never released
+				sf_static		= 4,
+				// property of an object, reachable only through that object
+				sf_owned		= 8
+			};
+
+			// every variable is one of these, stored inline in a page
+			// that is indexed directly by the variable's id
+			struct slot {
+				type_id type;
+				u8 flags;
+				u8 unused;
+				u32 size;
+				union {
+					integer_type i;
+					decimal_type d;
+					bool b;
+					void* ptr;
+					u8 bytes[8];
+				};
+
+				inline void* data() { return (flags & sf_external) || type_is_ptr(type) ? ptr : bytes; }
+			};
+
+			// view of a slot, kept for compatibility with code written
+			// before variables were stored in slots. modifying a mem_var
+			// does not modify the variable, use set() for that.
 			struct mem_var {
 				void* data;
 				size_t size;
@@ -16,23 +49,69 @@ namespace rs {
 				bool external;
 			};
 
+			// a string variable owns its buffer, set() takes 'data' (allocated
+			// with new[]) and frees the buffer the variable held before
 			void set(variable_id id, type_id type, size_t size, void* data);
 			variable_id set(type_id type, size_t size, void* data);
+			// stores another variable's value, strings are duplicated
+			void copy(variable_id id, const mem_var& value);
+			variable_id copy(const mem_var& value);
 			variable_id set_static(type_id type, size_t size, void* data);
 			variable_id inject(type_id type, size_t size, void* ptr);
-			mem_var& get(variable_id id);
 
-			void deallocate(variable_id id);
+			// returns null if the variable doesn't exist
+			inline slot* at(variable_id id) {
+				u64 page = id >> page_shift;
+				if (page >= m_page_count || !m_pages[page]) return nullptr;
+				slot* s = m_pages[page] + (id & page_mask);
+				return (s->flags & sf_allocated) ? s : nullptr;
+			}
+
+			inline mem_var get(variable_id id) {
+				slot* s = at(id);
+				if (!s || s->type == rs_builtin_type::t_null) return { nullptr, 0, 0, true };
+				return { s->data(), s->size, s->type, (s->flags & (sf_external | sf_static)) != 0 };
+			}
+
+			// ids that are referenced by instructions must not be recycled
+			void deallocate(variable_id id, bool recycle_id = true);
+
+			template <typename F>
+			void for_each(F&& callback) {
+				for (u64 p = 0;p < m_page_count;p++) {
+					if (!m_pages[p]) continue;
+					for (u64 i = 0;i < page_size;i++) {
+						if (m_pages[p][i].flags & sf_allocated) callback(m_pages[p][i]);
+					}
+				}
+			}
+
+			// number of allocated variables, now and at most
+			inline u64 allocated() const { return m_allocated; }
+			inline u64 high_water_mark() const { return m_high_water_mark; }
 
 		protected:
+			static const u64 page_shift = 10;
+			static const u64 page_size = 1 << page_shift;
+			static const u64 page_mask = page_size - 1;
+
+			slot* alloc(variable_id id);
+			void free_string(slot* s);
+
 			size_t m_max_memory;
 
-			munordered_map<variable_id, mem_var> m_vars;
-			munordered_map<variable_id, mem_var> m_static_vars;
+			// pages are never moved once allocated, so pointers to slot
+			// data stay valid until the variable is deallocated
+			slot** m_pages;
+			u64 m_page_count;
 
-			static variable_id next_var_id;
-			static mem_var null;
+			// ids of deallocated slots are reused by set(type, size, data). an id
+			// that set(id, ...) allocated again while it was here is skipped
+			dynamic_pod_array<variable_id> m_free_ids;
+			u64 m_allocated;
+			u64 m_high_water_mark;
+			variable_id m_next_var_id;
 	};
 
-	std::string var_tostring(context_memory::mem_var& v);
+	std::string var_tostring(const context_memory::mem_var& v);
 };
\ No newline at end of file
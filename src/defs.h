@@ -51,9 +51,8 @@ namespace rs {
 		pushState,
 		// if any registers are supplied as
 		// arguments, they will be copied to
-		// the parent state. return_value and
-		// instruction_address are always
-		// persisted
+		// the parent state. return_value is
+		// always persisted
 		popState,
 		pushScope,
 		popScope,
@@ -66,10 +65,6 @@ namespace rs {
 		this_obj,
 		// persisted only from old state, not to new state
 		return_value,
-		// set to rs_integer_max for new states
-		return_address,
-		// persisted from old state and to new state
-		instruction_address,
 		// persisted only to new state, not back from old state
 		lvalue,
 		// persisted only to new state, not back from old state
@@ -92,6 +87,16 @@ namespace rs {
 		parameter7,
 		// persisted only to new state, not back from old state
 		parameter_count,
+		// hold values that the compiler needs to keep while a subexpression is
+		// evaluated. never persisted to or from another state
+		scratch0,
+		scratch1,
+		scratch2,
+		scratch3,
+		scratch4,
+		scratch5,
+		scratch6,
+		scratch7,
 		register_count
 	};
 
@@ -116,6 +121,7 @@ namespace rs {
 	typedef uint16_t	u16;
 	typedef uint8_t		u8;
 	typedef uint16_t	type_id;
+	typedef uint32_t	atom_id;
 
 	inline bool type_is_ptr(type_id type) {
 		return 
@@ -149,22 +155,51 @@ namespace rs {
 
 	extern const size_t max_variable_size;
 
+	enum rs_trace_level {
+		trace_none = 0,
+		// only call and ret instructions
+		trace_calls,
+		// every instruction and its arguments
+		trace_instructions,
+		// every instruction, its source line and the values of its arguments
+		trace_verbose
+	};
+
 
 	class context;
+	class trace_sink;
 	struct context_parameters {
 		context* ctx;
 		struct {
-			size_t resize_amount = 16;
+			// number of instructions there's room for at first, after that the
+			// array doubles in size whenever it's full
 			size_t initial_size = 256;
 		} instruction_array;
 
+		struct {
+			// fold constant expressions and drop code that can't be reached. turning
+			// it off keeps the instructions closer to the source when debugging
+			bool optimize = true;
+		} compiler;
+
 		struct {
 			size_t max_stack_depth = 64;
 		} execution;
 
 		struct {
+			// 0 for no limit
 			size_t max_size = 0;
+			// heap size that triggers the first garbage collection, after that
+			// collections happen when the heap doubles in size
+			size_t collection_threshold = 256 * 1024;
 		} memory;
+
+		// only used when built with SCRIPTS_ENABLE_TRACE
+		struct {
+			rs_trace_level level = rs_trace_level::trace_none;
+			// if null, trace output is written to stdout
+			trace_sink* sink = nullptr;
+		} tracing;
 	};
 
 	struct func_args;
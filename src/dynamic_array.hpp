@@ -301,10 +301,15 @@ namespace rs {
 				m_count = 0;
 				if (m_capacity != 16) {
 					m_capacity = 16;
-					r2realloc(m_data, 0, sizeof(T) * 16);
+					m_data = (T*)r2realloc(m_data, 0, sizeof(T) * 16);
 				}
 			}
 
+			// removes elements from the end without shrinking the allocation
+			inline void truncate(size_t count) {
+				if (count < m_count) m_count = count;
+			}
+
 			inline size_t size() const { return m_count; }
 
 		protected:
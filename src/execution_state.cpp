@@ -1,19 +1,11 @@
 #include <execution_state.h>
 #include <context.h>
 #include <script_object.h>
+#include <trace.h>
+#include <instruction_sets.h>
 using namespace std;
 
 namespace rs {
-	runtime_exception::runtime_exception(const string& error, execution_state* state, const instruction_array::instruction& i) {
-		text = error;
-		auto src = state->ctx()->instructions->instruction_source(i.idx);
-		file = src.file;
-		line = src.line;
-		col = src.col;
-		lineText = src.lineText;
-		has_source_info = true;
-	}
-
 	runtime_exception::runtime_exception(const string& error, execution_state* state) {
 		text = error;
 
@@ -38,60 +30,67 @@ namespace rs {
 		m_ctx = ctx;
 		m_stack_idx = 0;
 		m_stack_depth = params.execution.max_stack_depth;
+		m_current_instruction_idx = 0;
+		m_instruction_addr = 0;
+		m_return_addrs = new integer_type[m_stack_depth];
+		for (size_t i = 0;i < m_stack_depth;i++) m_return_addrs[i] = rs_integer_max;
+		m_executed_count = 0;
 
 		const size_t rc = rs_register::register_count;
 		m_stack = (register_type(*)[rc])new register_type[rc * m_stack_depth];
-		memset(m_stack, 0, m_stack_depth * rc * sizeof(rs_register));
+		memset(m_stack, 0, m_stack_depth * rc * sizeof(register_type));
+
+		m_temporary_count = 0;
+		m_temporary_capacity = 32;
+		m_temporaries = new variable_id[m_temporary_capacity];
+		m_frame_temporaries = new size_t[m_stack_depth];
+		memset(m_frame_temporaries, 0, m_stack_depth * sizeof(size_t));
+
+		m_ctx->gc->add_state(this);
+
+		#ifdef SCRIPTS_ENABLE_TRACE
+		static file_trace_sink stdout_sink(stdout);
+		m_trace_level = params.tracing.level;
+		m_trace_sink = params.tracing.sink ? params.tracing.sink : &stdout_sink;
+		m_last_traced_line = -1;
+		m_last_traced_col = -1;
+		#endif
 	}
 
 	execution_state::~execution_state() {
+		while (m_scopes.size() > 0) close_scope(nullptr);
+		release_temporaries(0, nullptr);
+		m_ctx->gc->remove_state(this);
+		delete [] m_temporaries;
+		delete [] m_frame_temporaries;
+		delete [] m_return_addrs;
 		delete [] m_stack;
 	}
 
 	void execution_state::execute(integer_type entry_point, integer_type exit_point) {
-		integer_type instruction_addr = entry_point;
-		variable_id instruction_addr_id = m_ctx->memory->set(rs_builtin_type::t_integer, sizeof(integer_type), &instruction_addr);
-		registers()[rs_register::instruction_address] = instruction_addr_id;
-		integer_type return_addr = rs_integer_max;
-		variable_id return_addr_id = m_ctx->memory->set(rs_builtin_type::t_integer, sizeof(integer_type), &return_addr);
-		registers()[rs_register::return_address] = return_addr_id;
-
-		const context::instruction_set* default_iset = m_ctx->get_instruction_set(0);
-
-		m_last_printed_col = -1;
-		m_last_printed_line = -1;
-		integer_type& iaddr = *(integer_type*)m_ctx->memory->get(instruction_addr_id).data;
-		instruction_array& iarr = *m_ctx->instructions;
-		if (exit_point == rs_integer_max) exit_point = iarr.count();
-		while (iaddr < exit_point) {
-			register_type* registers = this->registers();
-			m_current_instruction_idx = iaddr++;
-
-			auto& instruction = iarr[m_current_instruction_idx];
-			print_instruction(m_current_instruction_idx, instruction);
-			if (instruction.code == rs_instruction::null_instruction) continue;
-
-			const context::instruction_set* iset = default_iset;
-			if (instruction.arg_count > 0) {
-				context_memory::mem_var ba;
-				if (instruction.arg_is_register[0]) ba = m_ctx->memory->get(registers[instruction.args[0].reg]);
-				else ba = m_ctx->memory->get(instruction.args[0].var);
-				iset = m_ctx->get_instruction_set(ba.type);
-			}
-			
+		m_instruction_addr = entry_point;
+		m_return_addrs[m_stack_idx] = rs_integer_max;
 
-			instruction_callback icb = iset->callbacks[instruction.code];
-			if (!icb) icb = default_iset->callbacks[instruction.code];
+		if (exit_point == rs_integer_max) exit_point = m_ctx->instructions->count();
+		run_instructions(this, exit_point);
+	}
 
-			if (icb) icb(this, &instruction);
-			else {
-				throw runtime_exception(
-					"No instruction exists for this operation",
-					this,
-					instruction
-				);
-			}
-		}
+	void execution_state::reset() {
+		while (m_scopes.size() > 0) close_scope(nullptr);
+		release_temporaries(0, nullptr);
+
+		// frames above the current one were cleared when they were popped
+		memset(m_stack, 0, (m_stack_idx + 1) * rs_register::register_count * sizeof(register_type));
+		for (size_t i = 0;i <= m_stack_idx;i++) m_return_addrs[i] = rs_integer_max;
+		m_stack_idx = 0;
+		m_current_instruction_idx = 0;
+		m_instruction_addr = 0;
+		m_executed_count = 0;
+
+		#ifdef SCRIPTS_ENABLE_TRACE
+		m_last_traced_line = -1;
+		m_last_traced_col = -1;
+		#endif
 	}
 
 	void execution_state::push_state() {
@@ -104,16 +103,12 @@ namespace rs {
 
 		register_type* prev = m_stack[m_stack_idx++];
 		register_type* now = m_stack[m_stack_idx];
+		m_frame_temporaries[m_stack_idx] = m_temporary_count;
 		now[rs_register::lvalue] = prev[rs_register::lvalue];
 		now[rs_register::rvalue] = prev[rs_register::rvalue];
 		now[rs_register::this_obj] = prev[rs_register::this_obj];
 		for (u8 x = 0;x < 8;x++) now[rs_register::parameter0 + x] = prev[rs_register::parameter0 + x];
-		now[rs_register::instruction_address] = prev[rs_register::instruction_address];
-
-
-		integer_type return_addr = rs_integer_max;
-		variable_id return_addr_id = m_ctx->memory->set(rs_builtin_type::t_integer, sizeof(integer_type), &return_addr);
-		now[rs_register::return_address] = return_addr_id;
+		m_return_addrs[m_stack_idx] = rs_integer_max;
 	}
 
 	void execution_state::pop_state(rs_register persist) {
@@ -126,102 +121,168 @@ namespace rs {
 		register_type* prev = m_stack[m_stack_idx--];
 		register_type* now = m_stack[m_stack_idx];
 		now[rs_register::return_value] = prev[rs_register::return_value];
-		now[rs_register::instruction_address] = prev[rs_register::instruction_address];
 		now[persist] = prev[persist];
 
-		m_ctx->memory->deallocate(prev[rs_register::return_address]);
-		memset(prev, 0, rs_register::register_count * sizeof(rs_register));
+		// scopes left open by the popped frame (by returning from inside of a block)
+		while (m_scopes.size() > 0 && m_scopes[m_scopes.size() - 1]->frame > m_stack_idx) close_scope(now);
 
+		// the popped frame's temporaries that were just persisted now belong to this frame
+		release_temporaries(m_frame_temporaries[m_stack_idx], now);
+		memset(prev, 0, rs_register::register_count * sizeof(register_type));
 	}
 
 	void execution_state::push_scope() {
+		m_scopes.push({ m_stack_idx, m_scope_vars.size() });
 	}
 
 	void execution_state::pop_scope() {
+		register_type* regs = registers();
+		if (m_scopes.size() > 0 && m_scopes[m_scopes.size() - 1]->frame == m_stack_idx) close_scope(regs);
+		release_temporaries(m_frame_temporaries[m_stack_idx], regs);
+	}
+
+	void execution_state::scope_allocated(variable_id id) {
+		// variables allocated outside of any scope are globals
+		if (m_scopes.size() == 0) return;
+		m_scope_vars.push(id);
+	}
+
+	void execution_state::close_scope(register_type* keep) {
+		size_t first = m_scopes[m_scopes.size() - 1]->first_var;
+		m_scopes.remove(m_scopes.size() - 1);
+
+		while (m_scope_vars.size() > first) {
+			size_t idx = m_scope_vars.size() - 1;
+			variable_id id = *m_scope_vars[idx];
+			m_scope_vars.remove(idx);
+
+			variable_id copy = 0;
+			for (u8 r = 0;keep && r < rs_register::register_count;r++) {
+				if (keep[r] != id) continue;
+				if (!copy) {
+					copy = m_ctx->memory->copy(m_ctx->memory->get(id));
+					add_temporary(copy);
+				}
+				keep[r] = copy;
+			}
+
+			// the id of a local is part of the instructions that use it, so it can't be
+			// given to another variable
+			m_ctx->memory->deallocate(id, false);
+		}
+	}
+
+	// whether a register other than 'skip' refers to 'id'
+	static inline bool referenced(const register_type* regs, variable_id id, rs_register skip) {
+		for (u8 r = 0;r < rs_register::register_count;r++) {
+			if (r != skip && regs[r] == id) return true;
+		}
+		return false;
+	}
+
+	variable_id execution_state::temporary(rs_register reg, type_id type, size_t size, void* data) {
+		register_type* regs = registers();
+
+		// reuse one of this frame's temporaries that nothing refers to anymore,
+		// including the one that is about to be replaced in 'reg'
+		for (size_t t = m_temporary_count;t > m_frame_temporaries[m_stack_idx];t--) {
+			variable_id id = m_temporaries[t - 1];
+			if (!referenced(regs, id, reg)) {
+				m_ctx->memory->set(id, type, size, data);
+				return id;
+			}
+		}
+
+		// popState overwrites the previous frame's return_value with this one's, so
+		// when that holds one of the previous frame's temporaries that none of its
+		// other registers refer to, the result reuses it and it becomes this frame's.
+		// this frame can only refer to the previous frame's temporaries through the
+		// registers it was given by push_state, which the previous frame still has.
+		// otherwise a c++ function called in a loop allocates a result each call and
+		// releases the last one when the call's frame is popped
+		if (reg == rs_register::return_value && m_stack_idx > 0) {
+			register_type* below = m_stack[m_stack_idx - 1];
+			variable_id id = below[reg];
+			if (id && !referenced(below, id, reg)) {
+				size_t& first = m_frame_temporaries[m_stack_idx];
+				for (size_t t = m_frame_temporaries[m_stack_idx - 1];t < first;t++) {
+					if (m_temporaries[t] != id) continue;
+
+					// the last of the previous frame's temporaries is where this frame's start
+					m_temporaries[t] = m_temporaries[first - 1];
+					m_temporaries[--first] = id;
+
+					m_ctx->memory->set(id, type, size, data);
+					return id;
+				}
+			}
+		}
+
+		variable_id id = m_ctx->memory->set(type, size, data);
+		add_temporary(id);
+		return id;
 	}
 
-	void execution_state::print_instruction(integer_type idx, const instruction_array::instruction& i) {
-		static const char* istr[] = {
-			"null",
-			"store",
-			"newObj",
-			"addProto",
-			"prop",
-			"propAssign",
-			"move",
-			"add",
-			"sub",
-			"mul",
-			"div",
-			"mod",
-			"pow",
-			"or",
-			"and",
-			"less",
-			"greater",
-			"addEq",
-			"subEq",
-			"mulEq",
-			"divEq",
-			"modEq",
-			"powEq",
-			"orEq",
-			"andEq",
-			"lessEq",
-			"greaterEq",
-			"compare",
-			"inc",
-			"dec",
-			"branch",
-			"clearParams",
-			"call",
-			"jump",
-			"ret",
-			"pushState",
-			"popState",
-			"pushScope",
-			"popScope"
-		};
-		static const char* rstr[] = {
-			"null",
-			"this_obj",
-			"return_val",
-			"return_address",
-			"instruction_address",
-			"lvalue",
-			"rvalue",
-			"parameter0",
-			"parameter1",
-			"parameter2",
-			"parameter3",
-			"parameter4",
-			"parameter5",
-			"parameter6",
-			"parameter7",
-			"parameter_count"
-		};
-
-		auto src = m_ctx->instructions->instruction_source(idx);
-
-		if (src.line != m_last_printed_line || src.col != m_last_printed_col) {
-			printf("\n\n%s\n", src.lineText.c_str());
+	void execution_state::add_temporary(variable_id id) {
+		if (m_temporary_count == m_temporary_capacity) {
+			m_temporaries = (variable_id*)r2realloc(m_temporaries, m_temporary_capacity * sizeof(variable_id), m_temporary_capacity * 2 * sizeof(variable_id));
+			m_temporary_capacity *= 2;
 		}
-		m_last_printed_line = src.line;
-		m_last_printed_col = src.col;
-		for (int c = 0;c < int(src.col);c++) printf(" ");
-		printf("^ ");
-		printf(istr[i.code]);
+		m_temporaries[m_temporary_count++] = id;
+	}
+
+	void execution_state::release_temporaries(size_t first, register_type* keep) {
+		size_t count = first;
+		for (size_t t = first;t < m_temporary_count;t++) {
+			variable_id id = m_temporaries[t];
+
+			bool referenced = false;
+			if (keep) {
+				for (u8 r = 0;r < rs_register::register_count && !referenced;r++) referenced = keep[r] == id;
+			}
+
+			if (referenced) m_temporaries[count++] = id;
+			else m_ctx->memory->deallocate(id);
+		}
+
+		m_temporary_count = count;
+	}
+
+	#ifdef SCRIPTS_ENABLE_TRACE
+	void execution_state::trace_instruction(integer_type idx, const instruction_array::instruction& i) {
+		if (m_trace_level == rs_trace_level::trace_calls) {
+			if (i.code != rs_instruction::call && i.code != rs_instruction::ret) return;
+		}
+
+		string line;
+		if (m_trace_level == rs_trace_level::trace_verbose) {
+			auto src = m_ctx->instructions->instruction_source(idx);
+			if (src.line != m_last_traced_line || src.col != m_last_traced_col) {
+				m_trace_sink->write("");
+				m_trace_sink->write(src.lineText);
+			}
+			m_last_traced_line = src.line;
+			m_last_traced_col = src.col;
+			line.append(src.col, ' ');
+			line += "^ ";
+		} else line = format("%d: ", idx);
+
+		line += instruction_name(i.code);
 		for (int a = 0;a < i.arg_count;a++) {
 			if (i.arg_is_register[a]) {
 				variable_id vid = registers()[i.args[a].reg];
-				auto& v = m_ctx->memory->get(vid);
-				printf(" $%s (#%llu) (%s)", rstr[i.args[a].reg], vid, var_tostring(v).c_str());
+				line += format(" $%s (#%llu)", register_name(i.args[a].reg), vid);
+				if (m_trace_level == rs_trace_level::trace_verbose) line += " (" + var_tostring(m_ctx->memory->get(vid)) + ")";
 			}
+			else if (i.arg_is_immediate[a]) line += format(" @%lld", (i64)i.args[a].imm);
 			else {
-				auto& v = m_ctx->memory->get(i.args[a].var);
-				printf(" #%llu (%s)", i.args[a].var, var_tostring(v).c_str());
+				line += format(" #%llu", i.args[a].var);
+				if (m_trace_level == rs_trace_level::trace_verbose) line += " (" + var_tostring(m_ctx->memory->get(i.args[a].var)) + ")";
 			}
 		}
-		printf(" [stack: %d]\n", m_stack_idx);
+		line += format(" [stack: %d]", m_stack_idx);
+
+		m_trace_sink->write(line);
 	}
+	#endif
 };
\ No newline at end of file
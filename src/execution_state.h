@@ -6,10 +6,10 @@
 namespace rs {
 	class context;
 	class execution_state;
+	class trace_sink;
 
 	class runtime_exception : public std::exception {
 		public:
-			runtime_exception(const std::string& error, execution_state* state, const instruction_array::instruction& i);
 			runtime_exception(const std::string& error, execution_state* state);
 			runtime_exception(const std::string& error);
 			~runtime_exception() { }
@@ -29,27 +29,82 @@ namespace rs {
 			~execution_state();
 
 			void execute(integer_type entry_point, integer_type exit_point = rs_integer_max);
+			// releases everything that the last execution left behind and clears the
+			// frames that it used, so the state can be reused as if it was new
+			void reset();
 
 			void push_state();
 			void pop_state(rs_register persist);
 			void push_scope();
 			void pop_scope();
-			void print_instruction(integer_type idx, const instruction_array::instruction& i);
+
+			// stores a value in a temporary variable owned by the current stack frame, to
+			// be assigned to register 'reg'. temporaries of this frame that no register
+			// refers to anymore are overwritten rather than allocating a new variable. for
+			// return_value, so is the previous frame's return_value, which popping this
+			// frame replaces. the temporary that's reused then belongs to this frame
+			variable_id temporary(rs_register reg, type_id type, size_t size, void* data);
+
+			// records that variable 'id' was first allocated while the innermost scope
+			// was active, it will be deallocated when that scope is popped
+			void scope_allocated(variable_id id);
+			#ifdef SCRIPTS_ENABLE_TRACE
+			void trace_instruction(integer_type idx, const instruction_array::instruction& i);
+			#endif
 			inline context* ctx() { return m_ctx; }
 			inline register_type* registers() { return m_stack[m_stack_idx]; }
+			inline register_type* frame(size_t idx) { return m_stack[idx]; }
+			inline size_t stack_idx() const { return m_stack_idx; }
 			inline integer_type instruction_addr() const { return m_current_instruction_idx; }
 
+			// address of the next instruction to execute
+			inline integer_type next_instruction_addr() const { return m_instruction_addr; }
+			inline void jump(integer_type addr) { m_instruction_addr = addr; }
+
+			// address that 'ret' will jump to from the frame above the current one
+			inline integer_type& return_addr() { return m_return_addrs[m_stack_idx]; }
+			inline u64 executed_count() const { return m_executed_count; }
+
 			struct scope {
-				dynamic_pod_array<variable_id> allocated_vars;
+				// stack frame that pushed the scope
+				size_t frame;
+				// index of the first variable in m_scope_vars allocated in the scope
+				size_t first_var;
 			};
 
 		protected:
-			u32 m_last_printed_line;
-			u32 m_last_printed_col;
+			friend void run_instructions(execution_state* state, integer_type exit_point);
+
+			#ifdef SCRIPTS_ENABLE_TRACE
+			rs_trace_level m_trace_level;
+			trace_sink* m_trace_sink;
+			u32 m_last_traced_line;
+			u32 m_last_traced_col;
+			#endif
 			register_type (*m_stack)[rs_register::register_count];
 			size_t m_stack_idx;
 			size_t m_stack_depth;
 			context* m_ctx;
 			integer_type m_current_instruction_idx;
+			integer_type m_instruction_addr;
+			// one per stack frame
+			integer_type* m_return_addrs;
+			u64 m_executed_count;
+
+			// temporaries are only ever referenced by registers, so any that aren't
+			// referenced by the registers of the frame that owns them can be released
+			void release_temporaries(size_t first, register_type* keep);
+			void add_temporary(variable_id id);
+			variable_id* m_temporaries;
+			size_t m_temporary_count;
+			size_t m_temporary_capacity;
+			// index of the first temporary owned by each stack frame
+			size_t* m_frame_temporaries;
+
+			// locals can be referenced by registers that outlive their scope (such
+			// as return_value), those registers are given a temporary copy instead
+			void close_scope(register_type* keep);
+			dynamic_pod_array<scope> m_scopes;
+			dynamic_pod_array<variable_id> m_scope_vars;
 	};
 };
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <garbage_collector.h>
+#include <context.h>
+#include <execution_state.h>
+#include <script_object.h>
+#include <chrono>
+using namespace std;
+using namespace std::chrono;
+
+namespace rs {
+	// number of objects swept per allocation while a sweep is in progress
+	static const size_t sweep_budget = 64;
+
+	garbage_collector::garbage_collector(const context_parameters& params) {
+		m_ctx = params.ctx;
+		m_max_size = params.memory.max_size;
+		m_initial_threshold = params.memory.collection_threshold;
+		if (m_max_size && m_initial_threshold > m_max_size) m_initial_threshold = m_max_size;
+		m_threshold = m_initial_threshold;
+		m_epoch = 0;
+		m_sweeping = false;
+		m_sweep_idx = 0;
+		m_sweep_end = 0;
+		m_sweep_write = 0;
+		memset(&m_stats, 0, sizeof(statistics));
+	}
+
+	garbage_collector::~garbage_collector() {
+		// objects before the sweep position may already be freed
+		if (m_sweeping) sweep(m_objects.size());
+		for (size_t i = 0;i < m_objects.size();i++) delete *m_objects[i];
+		m_objects.clear();
+		m_owners.clear();
+	}
+
+	void garbage_collector::track(script_object* obj, bool owns_id) {
+		obj->m_gc_epoch = m_epoch;
+		m_objects.push(obj);
+		m_stats.live_objects++;
+		if (owns_id) add_property(obj, obj->id());
+	}
+
+	void garbage_collector::add_property(script_object* obj, variable_id id) {
+		context_memory::slot* s = m_ctx->memory->at(id);
+		if (s) s->flags |= context_memory::sf_owned;
+		m_owners[id] = obj;
+	}
+
+	void garbage_collector::step() {
+		if (m_sweeping) {
+			auto start = high_resolution_clock::now();
+			sweep(sweep_budget);
+			record_pause(duration_cast<microseconds>(high_resolution_clock::now() - start).count());
+		} else if (heap_size() >= m_threshold && m_states.size() <= 1) {
+			// natives can hold pointers to objects that nothing else refers to while
+			// they call into a nested execution_state, so only collect when there is
+			// just one
+			auto start = high_resolution_clock::now();
+			mark();
+			record_pause(duration_cast<microseconds>(high_resolution_clock::now() - start).count());
+		}
+
+		if (m_max_size && heap_size() > m_max_size) {
+			if (m_states.size() <= 1) collect();
+			if (heap_size() > m_max_size) {
+				throw runtime_exception(format("Heap size exceeds the maximum of %llu bytes", u64(m_max_size)));
+			}
+		}
+	}
+
+	void garbage_collector::collect() {
+		auto start = high_resolution_clock::now();
+		if (m_sweeping) sweep(m_objects.size());
+		mark();
+		sweep(m_objects.size());
+		record_pause(duration_cast<microseconds>(high_resolution_clock::now() - start).count());
+	}
+
+	void garbage_collector::add_state(execution_state* state) {
+		m_states.push(state);
+	}
+
+	void garbage_collector::remove_state(execution_state* state) {
+		for (size_t i = 0;i < m_states.size();i++) {
+			if (*m_states[i] == state) {
+				m_states.remove(i);
+				return;
+			}
+		}
+	}
+
+	size_t garbage_collector::heap_size() const {
+		return m_stats.live_objects * sizeof(script_object) + m_ctx->memory->allocated() * sizeof(context_memory::slot);
+	}
+
+	void garbage_collector::mark() {
+		m_epoch++;
+		context_memory* mem = m_ctx->memory;
+
+		// any variable that isn't part of an object is a root
+		mem->for_each([this](context_memory::slot& s) {
+			if (s.type != rs_builtin_type::t_object || !s.ptr || (s.flags & context_memory::sf_owned)) return;
+			mark_object((script_object*)s.ptr);
+		});
+
+		// registers can refer to the properties of objects that are otherwise unreachable
+		for (size_t i = 0;i < m_states.size();i++) {
+			execution_state* state = *m_states[i];
+			for (size_t f = 0;f <= state->stack_idx();f++) {
+				register_type* registers = state->frame(f);
+				for (u8 r = 0;r < rs_register::register_count;r++) {
+					context_memory::slot* s = mem->at(registers[r]);
+					if (!s || !(s->flags & context_memory::sf_owned)) continue;
+
+					auto owner = m_owners.find(registers[r]);
+					if (owner != m_owners.end()) mark_object(owner->second);
+				}
+			}
+		}
+
+		while (m_mark_stack.size() > 0) {
+			size_t last = m_mark_stack.size() - 1;
+			script_object* obj = *m_mark_stack[last];
+			m_mark_stack.remove(last);
+
+			for (variable_id p : obj->m_slots) {
+				context_memory::slot* s = mem->at(p);
+				if (s && s->type == rs_builtin_type::t_object && s->ptr) mark_object((script_object*)s->ptr);
+			}
+		}
+
+		m_sweeping = true;
+		m_sweep_idx = 0;
+		m_sweep_write = 0;
+		m_sweep_end = m_objects.size();
+		m_stats.collections++;
+	}
+
+	void garbage_collector::mark_object(script_object* obj) {
+		if (obj->m_gc_epoch == m_epoch) return;
+		obj->m_gc_epoch = m_epoch;
+		m_mark_stack.push(obj);
+	}
+
+	void garbage_collector::sweep(size_t budget) {
+		while (m_sweep_idx < m_sweep_end && budget > 0) {
+			script_object* obj = *m_objects[m_sweep_idx++];
+			budget--;
+
+			if (obj->m_gc_epoch == m_epoch) *m_objects[m_sweep_write++] = obj;
+			else free_object(obj);
+		}
+
+		if (m_sweep_idx < m_sweep_end) return;
+
+		// objects allocated since the mark
+		for (size_t i = m_sweep_end;i < m_objects.size();i++) *m_objects[m_sweep_write++] = *m_objects[i];
+		m_objects.truncate(m_sweep_write);
+		m_sweeping = false;
+
+		m_threshold = heap_size() * 2;
+		if (m_threshold < m_initial_threshold) m_threshold = m_initial_threshold;
+		if (m_max_size && m_threshold > m_max_size) m_threshold = m_max_size;
+	}
+
+	void garbage_collector::free_object(script_object* obj) {
+		context_memory* mem = m_ctx->memory;
+		for (variable_id p : obj->m_slots) {
+			auto owner = m_owners.find(p);
+			if (owner == m_owners.end() || owner->second != obj) continue;
+
+			m_owners.erase(owner);
+			if (mem->at(p)) mem->deallocate(p);
+		}
+
+		auto owner = m_owners.find(obj->id());
+		if (owner != m_owners.end() && owner->second == obj) {
+			m_owners.erase(owner);
+			if (mem->at(obj->id())) mem->deallocate(obj->id());
+		}
+
+		delete obj;
+		m_stats.objects_freed++;
+		m_stats.live_objects--;
+	}
+
+	void garbage_collector::record_pause(u64 us) {
+		m_stats.last_pause_us = us;
+		m_stats.total_pause_us += us;
+		if (us > m_stats.max_pause_us) m_stats.max_pause_us = us;
+	}
+};
\ No newline at end of file
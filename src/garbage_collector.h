@@ -0,0 +1,74 @@
+#pragma once
+#include <defs.h>
+#include <dynamic_array.hpp>
+
+namespace rs {
+	class context;
+	class execution_state;
+	class script_object;
+
+	// objects created by scripts are collected when they can't be reached from
+	// any variable that isn't a property of an object, or from any register of a
+	// live execution_state. marking is done all at once, sweeping is spread out
+	// over the allocations that follow.
+	class garbage_collector {
+		public:
+			garbage_collector(const context_parameters& params);
+			~garbage_collector();
+
+			// takes ownership of obj. if 'owns_id' is true the variable obj->id()
+			// is only reachable through the object itself and isn't a root
+			void track(script_object* obj, bool owns_id);
+
+			// marks 'id' as belonging to obj, so it won't be treated as a root
+			void add_property(script_object* obj, variable_id id);
+
+			// called before objects are allocated, collects garbage when the heap
+			// has grown past the collection threshold
+			void step();
+			void collect();
+
+			void add_state(execution_state* state);
+			void remove_state(execution_state* state);
+
+			// estimated size of the heap in bytes
+			size_t heap_size() const;
+
+			struct statistics {
+				u64 collections;
+				u64 objects_freed;
+				u64 live_objects;
+				u64 last_pause_us;
+				u64 max_pause_us;
+				u64 total_pause_us;
+			};
+			inline const statistics& stats() const { return m_stats; }
+
+		protected:
+			void mark();
+			void mark_object(script_object* obj);
+			void sweep(size_t budget);
+			void free_object(script_object* obj);
+			void record_pause(u64 us);
+
+			context* m_ctx;
+			size_t m_max_size;
+			size_t m_threshold;
+			size_t m_initial_threshold;
+			u32 m_epoch;
+
+			dynamic_pod_array<script_object*> m_objects;
+			dynamic_pod_array<script_object*> m_mark_stack;
+			dynamic_pod_array<execution_state*> m_states;
+			munordered_map<variable_id, script_object*> m_owners;
+
+			// objects in [m_sweep_idx, m_sweep_end) have not been swept since the
+			// last mark, survivors are compacted to [0, m_sweep_write)
+			bool m_sweeping;
+			size_t m_sweep_idx;
+			size_t m_sweep_end;
+			size_t m_sweep_write;
+
+			statistics m_stats;
+	};
+};
\ No newline at end of file
@@ -4,22 +4,27 @@ using namespace std;
 
 namespace rs {
 	instruction_array::instruction_array(const context_parameters& params) {
-		m_capacity = params.instruction_array.initial_size;
-		m_blockSize = params.instruction_array.resize_amount;
+		m_capacity = params.instruction_array.initial_size > 0 ? params.instruction_array.initial_size : 1;
 		m_count = 0;
 
-		m_arr = new instruction[m_capacity];
-		m_srcMap = new internal_instruction_src[m_capacity];
+		m_shared = false;
+
+		m_arr = new encoded_instruction[m_capacity];
+		m_srcMap = new source_location[m_capacity];
+
+		m_constants.push_back(0);
+		m_constantIndices[0] = 0;
 	}
 
 	instruction_array::~instruction_array() {
-		delete [] m_arr;
-		delete [] m_srcMap;
+		if (!m_shared) {
+			delete [] m_arr;
+			delete [] m_srcMap;
+		}
 		m_arr = nullptr;
 		m_srcMap = nullptr;
 		m_count = 0;
 		m_capacity = 0;
-		m_blockSize = 0;
 	}
 
 
@@ -27,118 +32,227 @@ namespace rs {
 	instruction_array::instruction::instruction() {
 		code = rs_instruction::null_instruction;
 		memset(args, 0, sizeof(args));
-		memset(arg_is_register, 0, sizeof(bool) * 4);
+		memset(arg_is_register, 0, sizeof(arg_is_register));
+		memset(arg_is_immediate, 0, sizeof(arg_is_immediate));
 		arg_count = 0;
 	}
 
 	instruction_array::instruction::instruction(rs_instruction i) {
 		code = i;
 		memset(args, 0, sizeof(args));
-		memset(arg_is_register, 0, sizeof(bool) * 4);
+		memset(arg_is_register, 0, sizeof(arg_is_register));
+		memset(arg_is_immediate, 0, sizeof(arg_is_immediate));
 		arg_count = 0;
 	}
 
 
 
 	instruction_array::instruction& instruction_array::instruction::arg(rs_register reg) {
-		if (arg_count == 4) return *this;
+		if (arg_count == 3) return *this;
 		args[arg_count].reg = reg;
 		arg_is_register[arg_count++] = true;
 		return *this;
 	}
 
 	instruction_array::instruction& instruction_array::instruction::arg(variable_id var) {
-		if (arg_count == 4) return *this;
+		if (arg_count == 3) return *this;
 		args[arg_count].var = var;
 		arg_is_register[arg_count++] = false;
 		return *this;
 	}
 
+	instruction_array::instruction& instruction_array::instruction::imm(integer_type value) {
+		if (arg_count == 3) return *this;
+		args[arg_count].imm = value;
+		arg_is_immediate[arg_count++] = true;
+		return *this;
+	}
+
 
 
 	void instruction_array::backup() {
-		m_restorePoints.push(m_count);
+		m_restorePoints.push({ m_count, m_constants.size(), m_caches.size(), m_sources.size() });
 	}
 
 	void instruction_array::restore() {
-		m_count = m_restorePoints.top();
+		restore_point rp = m_restorePoints.top();
 		m_restorePoints.pop();
+
+		m_count = rp.count;
+		for (size_t c = rp.constant_count;c < m_constants.size();c++) {
+			// a shared constant pool can refer to the same variable more than once
+			auto it = m_constantIndices.find(m_constants[c]);
+			if (it != m_constantIndices.end() && it->second == c) m_constantIndices.erase(it);
+		}
+		m_constants.resize(rp.constant_count);
+		m_caches.resize(rp.cache_count);
+		m_sources.resize(rp.source_count);
 	}
 
 	void instruction_array::commit() {
 		m_restorePoints.pop();
 	}
 
-	instruction_array::instruction& instruction_array::append(const instruction& i, const string& file, u32 line, u32 col, const string& lineText) {
+	u32 instruction_array::add_source(const string& file, const string& code) {
+		return add_source(file, make_shared<const string>(code));
+	}
+
+	u32 instruction_array::add_source(const string& file, shared_ptr<const string> code) {
+		u32 fileIdx = 0;
+		auto it = m_srcFileIndices.find(file);
+		if (it != m_srcFileIndices.end()) fileIdx = it->second;
+		else {
+			fileIdx = m_srcFiles.size();
+			m_srcFiles.push_back(file);
+			m_srcFileIndices[file] = fileIdx;
+		}
+
+		m_sources.push_back({ fileIdx, std::move(code), {} });
+		return u32(m_sources.size() - 1);
+	}
+
+	string instruction_array::source_line(u32 source, u32 line) const {
+		const instruction_array::source& s = m_sources[source];
+		if (s.lineOffsets.empty()) find_lines(*s.code, s.lineOffsets);
+		if (line * 2 >= s.lineOffsets.size()) return "";
+
+		u32 start = s.lineOffsets[line * 2];
+		return s.code->substr(start, s.lineOffsets[line * 2 + 1] - start);
+	}
+
+	size_t instruction_array::append(const instruction& i, u32 source, u32 line, u32 col) {
 		if (m_count + 1 > rs_integer_max) {
 			throw parse_exception(
 				format("Script compiler was configured to use integers that are too small to contain more than %llu instructions. Update the configuration and recompile to increase the instruction capacity.", rs_integer_max),
-				file,
-				lineText,
+				m_srcFiles[m_sources[source].fileIdx],
+				source_line(source, line),
 				line,
 				col
 			);
 		}
 
-		if (m_count + 1 == m_capacity) {
-			instruction* newArr = new instruction[m_capacity + m_blockSize];
-			memcpy(newArr, m_arr, sizeof(instruction) * m_count);
-			delete [] m_arr;
-			m_arr = newArr;
-
-			internal_instruction_src* newSrcMap = new internal_instruction_src[m_capacity + m_blockSize];
-			memcpy(newSrcMap, m_srcMap, sizeof(internal_instruction_src) * m_count);
-			delete m_srcMap;
-			m_srcMap = newSrcMap;
-		}
+		// doubling keeps the cost of copying the instructions constant per
+		// instruction, no matter how long the program gets
+		if (m_shared || m_count == m_capacity) grow(m_capacity > 0 ? m_capacity * 2 : 1);
 
 		size_t idx = m_count++;
-		m_arr[idx] = i;
-		m_arr[idx].idx = idx;
-		internal_instruction_src src = {
-			0,
-			0,
-			line,
-			col
-		};
-
-		u32 vidx = 0;
-		for (const string& existing : m_srcFiles) {
-			if (file == existing) {
-				src.fileIdx = vidx;
-				vidx = 0;
-				break;
-			}
-			vidx++;
+		encoded_instruction& e = m_arr[idx];
+		e.code = i.code;
+		e.operand_info = 0;
+		e.unused = 0;
+		memset(e.operands, 0, sizeof(e.operands));
+		for (u8 a = 0;a < i.arg_count;a++) {
+			if (i.arg_is_register[a]) {
+				e.operands[a] = i.args[a].reg;
+				e.operand_info |= ok_register << (a * 2);
+			} else if (i.arg_is_immediate[a]) {
+				e.operands[a] = encode_immediate(i.args[a].imm, source, line, col);
+				e.operand_info |= ok_immediate << (a * 2);
+			} else e.operands[a] = add_constant(i.args[a].var);
 		}
-		if (vidx == m_srcFiles.size()) {
-			src.fileIdx = m_srcFiles.size();
-			m_srcFiles.push_back(file);
+		e.operand_info |= i.arg_count << 6;
+
+		m_srcMap[idx] = { source, line, col };
+		return idx;
+	}
+
+	void instruction_array::set_code(size_t idx, rs_instruction code) {
+		if (m_shared) grow(m_capacity);
+		m_arr[idx].code = code;
+	}
+
+	void instruction_array::add_arg(size_t idx, variable_id var) {
+		if (m_shared) grow(m_capacity);
+		encoded_instruction& e = m_arr[idx];
+		u8 arg_count = e.operand_info >> 6;
+		if (arg_count == 3) return;
+		e.operands[arg_count] = add_constant(var);
+		e.operand_info = (e.operand_info & 0x3F) | ((arg_count + 1) << 6);
+	}
+
+	void instruction_array::add_imm(size_t idx, integer_type value) {
+		if (m_shared) grow(m_capacity);
+		encoded_instruction& e = m_arr[idx];
+		u8 arg_count = e.operand_info >> 6;
+		if (arg_count == 3) return;
+		const source_location& loc = m_srcMap[idx];
+		e.operands[arg_count] = encode_immediate(value, loc.source, loc.line, loc.col);
+		e.operand_info = (e.operand_info & 0x3F) | (ok_immediate << (arg_count * 2)) | ((arg_count + 1) << 6);
+	}
+
+	u32 instruction_array::encode_immediate(integer_type value, u32 source, u32 line, u32 col) {
+		// immediates are addresses and indices, they're stored unsigned in 32 bits
+		if (value < 0 || u64(value) > UINT32_MAX) {
+			throw parse_exception(
+				format("Immediate value %lld can't be encoded in an instruction", (long long)value),
+				m_srcFiles[m_sources[source].fileIdx],
+				source_line(source, line),
+				line,
+				col
+			);
 		}
 
-		vidx = 0;
-		for (const string& existing : m_srcLines) {
-			if (lineText == existing) {
-				src.lineIdx = vidx;
-				break;
-			}
-			vidx++;
+		return u32(value);
+	}
+
+	void instruction_array::share(const encoded_instruction* instructions, const source_location* source_map, size_t count, const vector<variable_id>& constants) {
+		if (!m_shared) {
+			delete [] m_arr;
+			delete [] m_srcMap;
 		}
-		if (vidx == m_srcLines.size()) {
-			src.lineIdx = m_srcLines.size();
-			m_srcLines.push_back(lineText);
+
+		// they're only read until grow() copies them
+		m_arr = const_cast<encoded_instruction*>(instructions);
+		m_srcMap = const_cast<source_location*>(source_map);
+		m_capacity = count;
+		m_count = count;
+		m_shared = true;
+
+		m_constants = constants;
+		m_constantIndices.clear();
+		for (u32 c = 0;c < m_constants.size();c++) m_constantIndices.emplace(m_constants[c], c);
+	}
+
+	void instruction_array::grow(size_t capacity) {
+		encoded_instruction* arr = new encoded_instruction[capacity];
+		source_location* srcMap = new source_location[capacity];
+		memcpy(arr, m_arr, sizeof(encoded_instruction) * m_count);
+		memcpy(srcMap, m_srcMap, sizeof(source_location) * m_count);
+		if (!m_shared) {
+			delete [] m_arr;
+			delete [] m_srcMap;
 		}
 
-		m_srcMap[idx] = src;
-		return m_arr[idx];
+		m_arr = arr;
+		m_srcMap = srcMap;
+		m_capacity = capacity;
+		m_shared = false;
+	}
+
+	u32 instruction_array::add_constant(variable_id var) {
+		auto it = m_constantIndices.find(var);
+		if (it != m_constantIndices.end()) return it->second;
+
+		u32 idx = m_constants.size();
+		m_constants.push_back(var);
+		m_constantIndices[var] = idx;
+		return idx;
+	}
+
+	u32 instruction_array::add_property_cache(atom_id name) {
+		property_cache c;
+		memset(&c, 0, sizeof(property_cache));
+		c.name = name;
+		m_caches.push_back(c);
+		return u32(m_caches.size() - 1);
 	}
 
 	instruction_array::instruction_src instruction_array::instruction_source(integer_type idx) const {
 		instruction_src src;
 		src.col = m_srcMap[idx].col;
 		src.line = m_srcMap[idx].line;
-		src.file = m_srcFiles[m_srcMap[idx].fileIdx];
-		src.lineText = m_srcLines[m_srcMap[idx].lineIdx];
+		src.file = m_srcFiles[m_sources[m_srcMap[idx].source].fileIdx];
+		src.lineText = source_line(m_srcMap[idx].source, m_srcMap[idx].line);
 		return src;
 	}
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 #include <defs.h>
+#include <shape.h>
 #include <vector>
 #include <stack>
 #include <string>
+#include <memory>
 
 namespace rs {
 	class instruction_array {
@@ -10,33 +12,95 @@ namespace rs {
 			instruction_array(const context_parameters& params);
 			~instruction_array();
 
+			// decoded form of an instruction, used when building instructions and
+			// by instruction callbacks
 			struct instruction {
 				instruction();
 				instruction(rs_instruction i);
 
 				instruction& arg(rs_register reg);
 				instruction& arg(variable_id var);
+				instruction& imm(integer_type value);
 				
 				rs_instruction code;
 
 				union {
 					rs_register reg;
 					variable_id var;
-				} args[4];
-				bool arg_is_register[4];
+					// instruction address
+					integer_type imm;
+				} args[3];
+				bool arg_is_register[3];
+				bool arg_is_immediate[3];
 				u8 arg_count;
-				integer_type idx;
+			};
+
+			enum operand_kind {
+				ok_variable = 0,
+				ok_register = 1,
+				ok_immediate = 2
+			};
+
+			// packed form of an instruction, as it's stored in the array. variable
+			// operands are indices into the constant pool, register and immediate
+			// operands are stored as they are
+			struct encoded_instruction {
+				u8 code;
+				// bits 0-5: operand_kind of each operand, bits 6-7: operand count
+				u8 operand_info;
+				u16 unused;
+				u32 operands[3];
 			};
 
 			void backup();
 			void restore();
 			void commit();
 
-			instruction& append(const instruction& i, const std::string& file, u32 line, u32 col, const std::string& lineText);
-			inline instruction  operator[] (size_t idx) const { return m_arr[idx]; }
-			inline instruction& operator[] (size_t idx)       { return m_arr[idx]; }
+			// keeps a copy of 'code' so that the text of its lines can be looked up
+			// when an error is raised. returns the id of the source, instructions
+			// that are compiled from it are appended with that id
+			u32 add_source(const std::string& file, const std::string& code);
+			// the same, for code that is kept by something else as well
+			u32 add_source(const std::string& file, std::shared_ptr<const std::string> code);
+			// the text of a line of a source, for diagnostics
+			std::string source_line(u32 source, u32 line) const;
+			inline u32 source_count() const { return u32(m_sources.size()); }
+			inline const std::string& source_file(u32 source) const { return m_srcFiles[m_sources[source].fileIdx]; }
+			inline const std::string& source_code(u32 source) const { return *m_sources[source].code; }
+
+			// returns the index of the new instruction. appending can move the
+			// existing instructions, so they should only be modified by index
+			size_t append(const instruction& i, u32 source, u32 line, u32 col);
+			void set_code(size_t idx, rs_instruction code);
+			void add_arg(size_t idx, variable_id var);
+			void add_imm(size_t idx, integer_type value);
+
+			inline void decode(size_t idx, instruction& out) const {
+				const encoded_instruction& e = m_arr[idx];
+				const variable_id* constants = m_constants.data();
+				out.code = (rs_instruction)e.code;
+				out.arg_count = e.operand_info >> 6;
+				decode_operand(e, constants, 0, out);
+				decode_operand(e, constants, 1, out);
+				decode_operand(e, constants, 2, out);
+			}
+
+			inline instruction operator[] (size_t idx) const {
+				instruction i;
+				decode(idx, i);
+				return i;
+			}
+			inline const encoded_instruction& encoded(size_t idx) const { return m_arr[idx]; }
+			inline variable_id constant(u32 idx) const { return m_constants[idx]; }
+			inline u32 constant_count() const { return u32(m_constants.size()); }
 			inline size_t count() const { return m_count; }
 
+			// returns the index of a new, empty property_cache for the property
+			// 'name'. instructions refer to their cache with an immediate operand
+			u32 add_property_cache(atom_id name);
+			inline property_cache& cache(u32 idx) { return m_caches[idx]; }
+			inline u32 cache_count() const { return u32(m_caches.size()); }
+
 			struct instruction_src {
 				std::string file;
 				u32 line;
@@ -46,22 +110,76 @@ namespace rs {
 
 			instruction_src instruction_source(integer_type idx) const;
 
+			// where an instruction came from, as it's stored in the source map
+			struct source_location {
+				u32 source;
+				u32 line;
+				u32 col;
+			};
+
+			inline const source_location& location(size_t idx) const { return m_srcMap[idx]; }
+
+			// uses 'count' instructions and their source locations where they are
+			// instead of copying them, for instructions that belong to something
+			// that outlives this array (see program.h). 'constants' becomes the
+			// constant pool that their operands index. only an array that has no
+			// instructions, constants, caches or sources can share, and the
+			// instructions are copied the first time they would be modified
+			void share(const encoded_instruction* instructions, const source_location* source_map, size_t count, const std::vector<variable_id>& constants);
+			inline bool is_shared() const { return m_shared; }
+
 
 		protected:
-			struct internal_instruction_src {
+			struct source {
 				u32 fileIdx;
-				u32 lineIdx;
-				u32 line;
-				u32 col;
+				std::shared_ptr<const std::string> code;
+				// where each line starts and ends in code, found the first time
+				// the text of a line is requested
+				mutable std::vector<u32> lineOffsets;
 			};
-			instruction* m_arr;
-			internal_instruction_src* m_srcMap;
+			u32 add_constant(variable_id var);
+			// moves the instructions and source map to arrays of 'capacity' that
+			// this array owns
+			void grow(size_t capacity);
+			// branchless, register and immediate operands look up the null constant
+			// and throw it away. unused operands decode as the null constant
+			static inline void decode_operand(const encoded_instruction& e, const variable_id* constants, u8 a, instruction& out) {
+				u8 kind = (e.operand_info >> (a * 2)) & 3;
+				variable_id constant = constants[kind == ok_variable ? e.operands[a] : 0];
+				out.arg_is_register[a] = kind == ok_register;
+				out.arg_is_immediate[a] = kind == ok_immediate;
+				out.args[a].var = kind == ok_variable ? constant : e.operands[a];
+			}
+			// throws if 'value' doesn't fit in an operand
+			u32 encode_immediate(integer_type value, u32 source, u32 line, u32 col);
+
+			struct restore_point {
+				size_t count;
+				size_t constant_count;
+				size_t cache_count;
+				size_t source_count;
+			};
+
+			// only the encoded instructions are read while executing. where they
+			// came from is kept apart in m_srcMap, which is only read for errors
+			// and traces. both have room for m_capacity instructions, and neither
+			// belongs to this array while m_shared is set
+			encoded_instruction* m_arr;
+			source_location* m_srcMap;
 			size_t m_capacity;
 			size_t m_count;
-			size_t m_blockSize;
+			bool m_shared;
 
 			std::vector<std::string> m_srcFiles;
-			std::vector<std::string> m_srcLines;
-			std::stack<size_t> m_restorePoints;
+			munordered_map<std::string, u32> m_srcFileIndices;
+			std::vector<source> m_sources;
+			std::stack<restore_point> m_restorePoints;
+
+			// each distinct variable referenced by an instruction, deduplicated.
+			// index 0 is always the null variable
+			std::vector<variable_id> m_constants;
+			munordered_map<variable_id, u32> m_constantIndices;
+
+			std::vector<property_cache> m_caches;
 	};
 };
\ No newline at end of file
@@ -14,8 +14,7 @@ namespace rs {
 	using instruction = instruction_array::instruction;
 
 	inline void vstore(context* ctx, variable_id dst, variable_id src) {
-		mem_var src_v = ctx->memory->get(src);
-		ctx->memory->set(dst, src_v.type, src_v.size, src_v.data);
+		ctx->memory->copy(dst, ctx->memory->get(src));
 	}
 
 	inline integer_type ipow(integer_type base, integer_type exp) {
@@ -35,10 +34,10 @@ namespace rs {
 		return result;
 	}
 
-	inline void nan_result(context* ctx, register_type* registers) {
+	inline void nan_result(execution_state* state) {
 		decimal_type nan = rs_nan;
-		variable_id nan_id = ctx->memory->set(rs_builtin_type::t_decimal, sizeof(decimal_type), &nan);
-		registers[rs_register::rvalue] = nan_id;
+		variable_id nan_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_decimal, sizeof(decimal_type), &nan);
+		state->registers()[rs_register::rvalue] = nan_id;
 	}
 
 	inline void df_store(execution_state* state, instruction* i) {
@@ -53,7 +52,9 @@ namespace rs {
 		if (i->arg_is_register[0]) dst_id = registers[i->args[0].reg];
 		else dst_id = i->args[0].var;
 
-		ctx->memory->set(dst_id, src.type, src.size, src.data);
+		bool allocated = !ctx->memory->at(dst_id);
+		ctx->memory->copy(dst_id, src);
+		if (allocated) state->scope_allocated(dst_id);
 	}
 	inline void df_addProto(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -65,25 +66,32 @@ namespace rs {
 
 		throw runtime_exception(
 			format("'%s' is not an object", var_tostring(a).c_str()),
-			state,
-			*i
+			state
 		);
 	}
 	inline void df_newObj(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
+		ctx->gc->step();
+
 		if (i->arg_count > 0) {
 			if (i->arg_is_register[0]) {
 				auto obj = new script_object(ctx);
 				obj->set_id(ctx->memory->set(rs_builtin_type::t_object, sizeof(script_object*), obj));
+				ctx->gc->track(obj, true);
 				state->registers()[i->args[0].reg] = obj->id();
 			} else {
 				auto obj = new script_object(ctx);
 				obj->set_id(i->args[0].var);
+				bool allocated = !ctx->memory->at(i->args[0].var);
 				ctx->memory->set(i->args[0].var, rs_builtin_type::t_object, sizeof(script_object*), obj);
+				if (allocated) state->scope_allocated(i->args[0].var);
+				// the variable is a local, not part of the object
+				ctx->gc->track(obj, false);
 			}
 		} else {
 			auto obj = new script_object(ctx);
 			obj->set_id(ctx->memory->set(rs_builtin_type::t_object, sizeof(script_object*), obj));
+			ctx->gc->track(obj, true);
 			state->registers()[rs_register::lvalue] = obj->id();
 		}
 	}
@@ -97,8 +105,7 @@ namespace rs {
 
 		throw runtime_exception(
 			format("'%s' is not an object", var_tostring(a).c_str()),
-			state,
-			*i
+			state
 		);
 	}
 	inline void df_propAssign(execution_state* state, instruction* i) {
@@ -111,8 +118,7 @@ namespace rs {
 
 		throw runtime_exception(
 			format("'%s' is not an object", var_tostring(a).c_str()),
-			state,
-			*i
+			state
 		);
 	}
 	inline void df_move(execution_state* state, instruction* i) {
@@ -139,8 +145,7 @@ namespace rs {
 			for (;x < a.size;x++) {
 				if (((u8*)a.data)[x]) {
 					u8 v = 1;
-					registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-					// todo: add allocated rvalue to scope allocated variable ids 
+					registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 					return;
 				}
 			}
@@ -151,16 +156,14 @@ namespace rs {
 			for (;x < b.size;x++) {
 				if (((u8*)b.data)[x]) {
 					u8 v = 1;
-					registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-					// todo: add allocated rvalue to scope allocated variable ids 
+					registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 					return;
 				}
 			}
 		}
 
 		u8 v = 0;
-		registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-		// todo: add allocated rvalue to scope allocated variable ids 
+		registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 	}
 	inline void df_and(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -191,16 +194,14 @@ namespace rs {
 				}
 				if (x < b.size) {
 					u8 v = 1;
-					registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-					// todo: add allocated rvalue to scope allocated variable ids 
+					registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 					return;
 				}
 			}
 		}
 
 		u8 v = 0;
-		registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-		// todo: add allocated rvalue to scope allocated variable ids 
+		registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 	}
 	inline void df_compare(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -218,21 +219,18 @@ namespace rs {
 			for (size_t x = 0;x < a.size;x++) {
 				if (((u8*)a.data)[x] != ((u8*)b.data)[x]) {
 					u8 v = 0;
-					registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-					// todo: add allocated rvalue to scope allocated variable ids 
+					registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 					return;
 				}
 			}
 
 			u8 v = 1;
-			registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-			// todo: add allocated rvalue to scope allocated variable ids 
+			registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 			return;
 		}
 
 		u8 v = 0;
-		registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_bool, 1, &v);
-		// todo: add allocated rvalue to scope allocated variable ids 
+		registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, 1, &v);
 	}
 
 	inline void df_orEq(execution_state* state, instruction* i) {
@@ -270,11 +268,11 @@ namespace rs {
 
 		for (size_t x = 0;x < cond.size;x++) {
 			if (((u8*)cond.data)[x]) {
-				vstore(ctx, registers[rs_register::instruction_address], i->args[1].var);
+				state->jump(i->args[1].imm);
 				return;
 			}
 		}
-		vstore(ctx, registers[rs_register::instruction_address], i->args[2].var);
+		state->jump(i->args[2].imm);
 	}
 	inline void df_clearParams(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -308,42 +306,38 @@ namespace rs {
 			script_object* this_obj = nullptr;
 			variable_id this_obj_id = registers[rs_register::this_obj];
 			if (this_obj_id != 0) {
-				mem_var& obj = ctx->memory->get(this_obj_id);
+				mem_var obj = ctx->memory->get(this_obj_id);
 				if (obj.type == rs_builtin_type::t_object) this_obj = (script_object*)obj.data;
 			}
 
-			func_args args;
-			args.state = state;
-			args.context = ctx;
-			args.self = this_obj;
-			for (u8 arg = 0;arg < 8;arg++) {
-				variable_id arg_id = registers[rs_register::parameter0 + arg];
-				args.parameters.push({
-					ctx->memory->get(arg_id),
-					arg_id
-					});
-			}
+			// parameters that weren't passed were cleared before the call
+			u8 arg_count = 8;
+			while (arg_count > 0 && registers[rs_register::parameter0 + arg_count - 1] == 0) arg_count--;
 
+			func_args args = {
+				this_obj,
+				ctx,
+				state,
+				func,
+				func_args::arg_span(ctx->memory, &registers[rs_register::parameter0], arg_count)
+			};
 			registers[rs_register::return_value] = func->cpp_callback(&args);
 		} else {
-			vstore(ctx, registers[rs_register::return_address], registers[rs_register::instruction_address]);
+			state->return_addr() = state->next_instruction_addr();
 
 			state->push_state();
 			state->push_scope();
 
-			vstore(ctx, registers[rs_register::instruction_address], func->entry_point_id);
+			state->jump(func->entry_point);
 		}
 	}
 	inline void df_jump(execution_state* state, instruction* i) {
-		context* ctx = state->ctx();
-		register_type* registers = state->registers();
-		vstore(ctx, registers[rs_register::instruction_address], i->args[0].var);
+		state->jump(i->args[0].imm);
 	}
 	inline void df_ret(execution_state* state, instruction* i) {
 		state->pop_scope();
 		state->pop_state(rs_register::null_register);
-		register_type* registers = state->registers();
-		vstore(state->ctx(), registers[rs_register::instruction_address], registers[rs_register::return_address]);
+		state->jump(state->return_addr());
 	}
 	inline void df_pushState(execution_state* state, instruction* i) {
 		state->push_state();
@@ -371,14 +365,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-		) return nan_result(ctx, registers);
+		) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = (*(integer_type*)a.data) + (*(integer_type*)b.data);
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -394,14 +388,13 @@ namespace rs {
 			}
 
 			av += bv;
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_sub(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -416,14 +409,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-		) return nan_result(ctx, registers);
+		) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = (*(integer_type*)a.data) - (*(integer_type*)b.data);
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -439,14 +432,13 @@ namespace rs {
 			}
 
 			av -= bv;
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_mul(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -461,14 +453,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = (*(integer_type*)a.data) * (*(integer_type*)b.data);
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -484,14 +476,13 @@ namespace rs {
 			}
 
 			av *= bv;
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_div(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -506,14 +497,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = (*(integer_type*)a.data) / (*(integer_type*)b.data);
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -529,14 +520,13 @@ namespace rs {
 			}
 
 			av /= bv;
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_mod(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -551,14 +541,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = (*(integer_type*)a.data) % (*(integer_type*)b.data);
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -574,14 +564,13 @@ namespace rs {
 			}
 
 			av = fmod(av, bv);
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_pow(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -596,14 +585,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			integer_type result = ipow((*(integer_type*)a.data), (*(integer_type*)b.data));
-			result_id = ctx->memory->set(type, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(integer_type), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -619,14 +608,13 @@ namespace rs {
 			}
 
 			av = ::pow(av, bv);
-			result_id = ctx->memory->set(type, sizeof(decimal_type), &av);
+			result_id = state->temporary(rs_register::rvalue, type, sizeof(decimal_type), &av);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_less(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -641,14 +629,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			u8 result = (*(integer_type*)a.data) < (*(integer_type*)b.data) ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -664,14 +652,13 @@ namespace rs {
 			}
 
 			u8 result = av < bv ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_greater(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -686,14 +673,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			u8 result = (*(integer_type*)a.data) > (*(integer_type*)b.data) ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -709,14 +696,13 @@ namespace rs {
 			}
 
 			u8 result = av > bv ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_compare(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -731,14 +717,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			u8 result = (*(integer_type*)a.data) == (*(integer_type*)b.data) ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -754,14 +740,13 @@ namespace rs {
 			}
 
 			u8 result = av == bv ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 
 	inline void num_addEq(execution_state* state, instruction* i) {
@@ -849,14 +834,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			u8 result = (*(integer_type*)a.data) <= (*(integer_type*)b.data) ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -872,14 +857,13 @@ namespace rs {
 			}
 
 			u8 result = av <= bv ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_greaterEq(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -894,14 +878,14 @@ namespace rs {
 		if (
 			!a.type || !b.type || a.size == 0 || b.size == 0 ||
 			a.type > rs_builtin_type::t_decimal || b.type > rs_builtin_type::t_decimal
-			) return nan_result(ctx, registers);
+			) return nan_result(state);
 
 		type_id type = max(a.type, b.type);
 
 		variable_id result_id = 0;
 		if (type == rs_builtin_type::t_integer) {
 			u8 result = (*(integer_type*)a.data) >= (*(integer_type*)b.data) ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		} else {
 			decimal_type av = 0;
 			decimal_type bv = 0;
@@ -917,14 +901,13 @@ namespace rs {
 			}
 
 			u8 result = av >= bv ? 1 : 0;
-			result_id = ctx->memory->set(rs_builtin_type::t_bool, sizeof(u8), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_bool, sizeof(u8), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_inc(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -933,22 +916,21 @@ namespace rs {
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
 		mem_var a = ctx->memory->get(a_id);
 
-		if (!a.type || a.size == 0 || a.type > rs_builtin_type::t_decimal) return nan_result(ctx, registers);
+		if (!a.type || a.size == 0 || a.type > rs_builtin_type::t_decimal) return nan_result(state);
 
 		variable_id result_id = 0;
 		if (a.type == rs_builtin_type::t_integer) {
 			integer_type result = *(integer_type*)a.data + integer_type(1);
-			result_id = ctx->memory->set(rs_builtin_type::t_integer, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_integer, sizeof(integer_type), &result);
 		} else {
 			decimal_type result = *(decimal_type*)a.data + decimal_type(1);
-			result_id = ctx->memory->set(rs_builtin_type::t_decimal, sizeof(decimal_type), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_decimal, sizeof(decimal_type), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 	inline void num_dec(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -957,22 +939,21 @@ namespace rs {
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
 		mem_var a = ctx->memory->get(a_id);
 
-		if (!a.type || a.size == 0 || a.type > rs_builtin_type::t_decimal) return nan_result(ctx, registers);
+		if (!a.type || a.size == 0 || a.type > rs_builtin_type::t_decimal) return nan_result(state);
 
 		variable_id result_id = 0;
 		if (a.type == rs_builtin_type::t_integer) {
 			integer_type result = *(integer_type*)a.data - integer_type(1);
-			result_id = ctx->memory->set(rs_builtin_type::t_integer, sizeof(integer_type), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_integer, sizeof(integer_type), &result);
 		} else {
 			decimal_type result = *(decimal_type*)a.data - decimal_type(1);
-			result_id = ctx->memory->set(rs_builtin_type::t_decimal, sizeof(decimal_type), &result);
+			result_id = state->temporary(rs_register::rvalue, rs_builtin_type::t_decimal, sizeof(decimal_type), &result);
 		}
 
-		if (!result_id) nan_result(ctx, registers);
+		if (!result_id) nan_result(state);
 		else {
 			registers[rs_register::rvalue] = result_id;
 		}
-		// todo: add allocated rvalue to scope allocated variable ids 
 	}
 
 	inline void obj_addProto(execution_state* state, instruction* i) {
@@ -990,49 +971,94 @@ namespace rs {
 
 		obj->add_prototype(proto, false, nullptr, 0);
 	}
-	inline void obj_prop(execution_state* state, instruction* i) {
-		context* ctx = state->ctx();
-		register_type* registers = state->registers();
-
-		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
-		variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
-		mem_var a = ctx->memory->get(a_id);
-		mem_var b = ctx->memory->get(b_id);
+	// returns the entry of 'cache' for 'shape', or nullptr
+	inline property_cache::entry* find_cache_entry(property_cache& cache, object_shape* shape) {
+		for (u8 e = 0;e < cache.count;e++) {
+			if (cache.entries[e].shape == shape) return &cache.entries[e];
+		}
+		return nullptr;
+	}
+	inline void add_cache_entry(property_cache& cache, const property_cache::entry& entry) {
+		// dictionary shapes change without the object getting a new shape
+		if (entry.shape->is_dictionary()) return;
+		if (entry.transition && entry.transition->is_dictionary()) return;
 
-		string propName;
+		if (cache.count < property_cache::max_entries) cache.entries[cache.count++] = entry;
+		else {
+			cache.entries[cache.next] = entry;
+			cache.next = (cache.next + 1) % property_cache::max_entries;
+		}
+	}
+	// returns the property name that 'b' refers to
+	inline string property_name(execution_state* state, const mem_var& b) {
 		switch (b.type) {
 			case rs_builtin_type::t_string: {
-				propName = string((char*)b.data, b.size);
-				break;
+				return string((char*)b.data, b.size);
 			}
 			case rs_builtin_type::t_integer: {
-				propName = format("%d", *(integer_type*)b.data);
-				break;
+				return format("%d", *(integer_type*)b.data);
 			}
 			case rs_builtin_type::t_decimal: {
-				propName = format("%f", *(decimal_type*)b.data);
-				break;
+				return format("%f", *(decimal_type*)b.data);
 			}
 			default: {
 				throw runtime_exception(
 					format("'%s' is not a valid property name or index", var_tostring(b).c_str()),
-					state,
-					*i
+					state
 				);
 			}
 		}
+		return "";
+	}
+	// returns the atom of the property accessed by 'i'. names that were never
+	// added to the atom table can't belong to any property, so they're only added
+	// when 'add' is true
+	inline atom_id property_atom(execution_state* state, instruction* i, property_cache* cache, bool add) {
+		if (cache) return cache->name;
 
+		context* ctx = state->ctx();
+		variable_id b_id = i->arg_is_register[1] ? state->registers()[i->args[1].reg] : i->args[1].var;
+		string name = property_name(state, ctx->memory->get(b_id));
+		return add ? ctx->atoms->get(name) : ctx->atoms->find(name);
+	}
+	inline void obj_prop(execution_state* state, instruction* i) {
+		context* ctx = state->ctx();
+		register_type* registers = state->registers();
+
+		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
+		mem_var a = ctx->memory->get(a_id);
 		script_object* obj = (script_object*)a.data;
-		variable_id prop_id = obj->property(propName);
-		if (prop_id == 0) {
-			prop_id = obj->proto_property(propName);
+		object_shape* shape = obj->shape();
+
+		// instructions that access a constant property name have a property cache
+		property_cache* cache = i->arg_is_immediate[2] ? &ctx->instructions->cache(u32(i->args[2].imm)) : nullptr;
+		if (cache) {
+			property_cache::entry* e = find_cache_entry(*cache, shape);
+			if (e) {
+				variable_id prop_id = e->kind == property_cache::ek_slot ? obj->slot(e->slot) : e->value;
+				if (i->arg_is_register[0]) registers[i->args[0].reg] = prop_id;
+				else registers[rs_register::lvalue] = prop_id;
+				return;
+			}
+		}
+
+		atom_id name = property_atom(state, i, cache, false);
+		variable_id prop_id = 0;
+		i32 slot = name ? shape->index(name) : -1;
+		if (slot != -1) {
+			prop_id = obj->slot(slot);
+			if (cache) add_cache_entry(*cache, { shape, nullptr, 0, u32(slot), property_cache::ek_slot });
+		} else {
+			prop_id = name ? obj->proto_property(name) : 0;
 			if (prop_id == 0) {
+				variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
 				throw runtime_exception(
-					format("Object has no property named '%s'", propName.c_str()),
-					state,
-					*i
+					format("Object has no property named '%s'", property_name(state, ctx->memory->get(b_id)).c_str()),
+					state
 				);
 			}
+			// the prototype is part of the shape
+			if (cache) add_cache_entry(*cache, { shape, nullptr, prop_id, 0, property_cache::ek_method });
 		}
 
 		if (i->arg_is_register[0]) registers[i->args[0].reg] = prop_id;
@@ -1043,37 +1069,33 @@ namespace rs {
 		register_type* registers = state->registers();
 
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
-		variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
 		mem_var a = ctx->memory->get(a_id);
-		mem_var b = ctx->memory->get(b_id);
-
-		string propName;
-		switch (b.type) {
-			case rs_builtin_type::t_string: {
-				propName = string((char*)b.data, b.size);
-				break;
-			}
-			case rs_builtin_type::t_integer: {
-				propName = format("%d", *(integer_type*)b.data);
-				break;
-			}
-			case rs_builtin_type::t_decimal: {
-				propName = format("%f", *(decimal_type*)b.data);
-				break;
-			}
-			default: {
-				throw runtime_exception(
-					format("'%s' is not a valid property name or index", var_tostring(b).c_str()),
-					state,
-					*i
-				);
+		script_object* obj = (script_object*)a.data;
+		object_shape* shape = obj->shape();
+
+		property_cache* cache = i->arg_is_immediate[2] ? &ctx->instructions->cache(u32(i->args[2].imm)) : nullptr;
+		if (cache) {
+			property_cache::entry* e = find_cache_entry(*cache, shape);
+			if (e) {
+				variable_id prop_id = 0;
+				if (e->kind == property_cache::ek_slot) prop_id = obj->slot(e->slot);
+				else prop_id = obj->define_property(e->transition, rs_builtin_type::t_null, 0, nullptr);
+
+				if (i->arg_is_register[0]) registers[i->args[0].reg] = prop_id;
+				else registers[rs_register::lvalue] = prop_id;
+				return;
 			}
 		}
 
-		script_object* obj = (script_object*)a.data;
-		variable_id prop_id = obj->property(propName);
-		if (prop_id == 0) {
-			prop_id = obj->define_property(propName, rs_builtin_type::t_null, 0, nullptr);
+		atom_id name = property_atom(state, i, cache, true);
+		variable_id prop_id = 0;
+		i32 slot = shape->index(name);
+		if (slot != -1) {
+			prop_id = obj->slot(slot);
+			if (cache) add_cache_entry(*cache, { shape, nullptr, 0, u32(slot), property_cache::ek_slot });
+		} else {
+			prop_id = obj->define_property(name, rs_builtin_type::t_null, 0, nullptr);
+			if (cache) add_cache_entry(*cache, { shape, obj->shape(), 0, obj->shape()->count() - 1, property_cache::ek_transition });
 		}
 
 		if (i->arg_is_register[0]) registers[i->args[0].reg] = prop_id;
@@ -1093,7 +1115,7 @@ namespace rs {
 
 		char* result = new char[a.length()];
 		memcpy(result, a.c_str(), a.length());
-		registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_string, a.length(), result);
+		registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_string, a.length(), result);
 	}
 	inline void str_addEq(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -1101,18 +1123,19 @@ namespace rs {
 
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
 		variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
-		mem_var& av = ctx->memory->get(a_id);
+		mem_var av = ctx->memory->get(a_id);
 		string a((char*)av.data, av.size);
 		string b = var_tostring(ctx->memory->get(b_id));
 		a += b;
 
 		char* result = new char[a.length()];
 		memcpy(result, a.c_str(), a.length());
-		registers[rs_register::rvalue] = ctx->memory->set(rs_builtin_type::t_string, a.length(), result);
+		registers[rs_register::rvalue] = state->temporary(rs_register::rvalue, rs_builtin_type::t_string, a.length(), result);
 
-		delete [] (char*)av.data;
-		av.data = new char[a.length()];
-		memcpy(av.data, a.c_str(), a.length());
+		// the temporary and the variable each own a buffer
+		char* updated = new char[a.length()];
+		memcpy(updated, a.c_str(), a.length());
+		ctx->memory->set(a_id, rs_builtin_type::t_string, a.length(), updated);
 	}
 	inline void str_prop(execution_state* state, instruction* i) {
 		context* ctx = state->ctx();
@@ -1129,8 +1152,7 @@ namespace rs {
 		} else {
 			throw runtime_exception(
 				format("'%s' is not a valid string index", var_tostring(b).c_str()),
-				state,
-				*i
+				state
 			);
 			return;
 		}
@@ -1138,15 +1160,14 @@ namespace rs {
 		if (idx < 0 || idx >= a.size) {
 			throw runtime_exception(
 				format("String index out of range"),
-				state,
-				*i
+				state
 			);
 			return;
 		}
 
 		char* result = new char[1];
 		*result = ((char*)a.data)[idx];
-		registers[rs_register::lvalue] = ctx->memory->set(rs_builtin_type::t_string, 1, result);
+		registers[rs_register::lvalue] = state->temporary(rs_register::lvalue, rs_builtin_type::t_string, 1, result);
 	}
 
 	inline void class_prop(execution_state* state, instruction* i) {
@@ -1154,44 +1175,22 @@ namespace rs {
 		register_type* registers = state->registers();
 
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
-		variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
 		mem_var a = ctx->memory->get(a_id);
-		mem_var b = ctx->memory->get(b_id);
 
-		string propName;
-		switch (b.type) {
-			case rs_builtin_type::t_string: {
-				propName = string((char*)b.data, b.size);
-				break;
-			}
-			case rs_builtin_type::t_integer: {
-				propName = format("%d", *(integer_type*)b.data);
-				break;
-			}
-			case rs_builtin_type::t_decimal: {
-				propName = format("%f", *(decimal_type*)b.data);
-				break;
-			}
-			default: {
-				throw runtime_exception(
-					format("'%s' is not a valid property name or index", var_tostring(b).c_str()),
-					state,
-					*i
-				);
-			}
-		}
+		property_cache* cache = i->arg_is_immediate[2] ? &ctx->instructions->cache(u32(i->args[2].imm)) : nullptr;
+		atom_id name = property_atom(state, i, cache, false);
 
 		object_prototype* proto = (object_prototype*)a.data;
-		variable_id prop_id = proto->static_variable(propName);
+		variable_id prop_id = name ? proto->static_variable(name) : 0;
 		if (prop_id == 0) {
-			script_function* func = proto->static_method(propName);
+			script_function* func = name ? proto->static_method(name) : nullptr;
 			if (func) {
 				prop_id = func->function_id;
 			} else {
+				variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
 				throw runtime_exception(
-					format("Class has no static property or method named '%s'", propName.c_str()),
-					state,
-					*i
+					format("Class has no static property or method named '%s'", property_name(state, ctx->memory->get(b_id)).c_str()),
+					state
 				);
 			}
 		}
@@ -1204,42 +1203,20 @@ namespace rs {
 		register_type* registers = state->registers();
 
 		variable_id a_id = i->arg_is_register[0] ? registers[i->args[0].reg] : i->args[0].var;
-		variable_id b_id = i->arg_is_register[1] ? registers[i->args[1].reg] : i->args[1].var;
 		mem_var a = ctx->memory->get(a_id);
-		mem_var b = ctx->memory->get(b_id);
 
-		string propName;
-		switch (b.type) {
-			case rs_builtin_type::t_string: {
-				propName = string((char*)b.data, b.size);
-				break;
-			}
-			case rs_builtin_type::t_integer: {
-				propName = format("%d", *(integer_type*)b.data);
-				break;
-			}
-			case rs_builtin_type::t_decimal: {
-				propName = format("%f", *(decimal_type*)b.data);
-				break;
-			}
-			default: {
-				throw runtime_exception(
-					format("'%s' is not a valid property name or index", var_tostring(b).c_str()),
-					state,
-					*i
-				);
-			}
-		}
+		property_cache* cache = i->arg_is_immediate[2] ? &ctx->instructions->cache(u32(i->args[2].imm)) : nullptr;
+		atom_id name = property_atom(state, i, cache, true);
 
 		object_prototype* proto = (object_prototype*)a.data;
-		variable_id prop_id = proto->static_variable(propName);
+		variable_id prop_id = proto->static_variable(name);
 		if (prop_id == 0) {
-			script_function* func = proto->static_method(propName);
+			script_function* func = proto->static_method(name);
 			if (func) {
 				prop_id = func->function_id;
 			} else {
 				prop_id = ctx->memory->set(rs_builtin_type::t_null, 0, nullptr);
-				proto->static_variable(propName, prop_id);
+				proto->static_variable(name, prop_id);
 			}
 		}
 
@@ -1249,26 +1226,75 @@ namespace rs {
 
 
 
+	// default handlers that run_instructions calls directly when no type
+	// overrides them
+	#define rs_inline_instructions(op) \
+		op(store, df_store) \
+		op(newObj, df_newObj) \
+		op(move, df_move) \
+		op(or, df_or) \
+		op(and, df_and) \
+		op(orEq, df_orEq) \
+		op(andEq, df_andEq) \
+		op(branch, df_branch) \
+		op(clearParams, df_clearParams) \
+		op(call, df_call) \
+		op(jump, df_jump) \
+		op(ret, df_ret) \
+		op(pushState, df_pushState) \
+		op(popState, df_popState) \
+		op(pushScope, df_pushScope) \
+		op(popScope, df_popScope)
+
+	// builtin handlers of both number types, run_instructions calls them directly
+	// when the first operand is a number and neither type's handler was replaced
+	#define rs_number_instructions(op) \
+		op(add, num_add) \
+		op(sub, num_sub) \
+		op(mul, num_mul) \
+		op(div, num_div) \
+		op(mod, num_mod) \
+		op(pow, num_pow) \
+		op(less, num_less) \
+		op(greater, num_greater) \
+		op(compare, num_compare) \
+		op(addEq, num_addEq) \
+		op(subEq, num_subEq) \
+		op(mulEq, num_mulEq) \
+		op(divEq, num_divEq) \
+		op(modEq, num_modEq) \
+		op(powEq, num_powEq) \
+		op(lessEq, num_lessEq) \
+		op(greaterEq, num_greaterEq) \
+		op(inc, num_inc) \
+		op(dec, num_dec)
+
+	inline instruction_callback number_callback(rs_instruction code) {
+		switch (code) {
+			#define op(code, handler) case rs_instruction::code: return handler;
+			rs_number_instructions(op)
+			#undef op
+			default: return nullptr;
+		}
+	}
+
+	inline instruction_callback inline_callback(rs_instruction code) {
+		switch (code) {
+			#define op(code, handler) case rs_instruction::code: return handler;
+			rs_inline_instructions(op)
+			#undef op
+			default: return nullptr;
+		}
+	}
+
 	void add_default_instruction_set(context* ctx) {
-		ctx->define_instruction(0, rs_instruction::store, df_store);
-		ctx->define_instruction(0, rs_instruction::newObj, df_newObj);
 		ctx->define_instruction(0, rs_instruction::prop, df_prop);
 		ctx->define_instruction(0, rs_instruction::propAssign, df_propAssign);
-		ctx->define_instruction(0, rs_instruction::move, df_move);
-		ctx->define_instruction(0, rs_instruction::or, df_or);
-		ctx->define_instruction(0, rs_instruction::and, df_and);
 		ctx->define_instruction(0, rs_instruction::compare, df_compare);
-		ctx->define_instruction(0, rs_instruction::orEq, df_orEq);
-		ctx->define_instruction(0, rs_instruction::andEq, df_andEq);
-		ctx->define_instruction(0, rs_instruction::branch, df_branch);
-		ctx->define_instruction(0, rs_instruction::clearParams, df_clearParams);
-		ctx->define_instruction(0, rs_instruction::call, df_call);
-		ctx->define_instruction(0, rs_instruction::jump, df_jump);
-		ctx->define_instruction(0, rs_instruction::ret, df_ret);
-		ctx->define_instruction(0, rs_instruction::pushState, df_pushState);
-		ctx->define_instruction(0, rs_instruction::popState, df_popState);
-		ctx->define_instruction(0, rs_instruction::pushScope, df_pushScope);
-		ctx->define_instruction(0, rs_instruction::popScope, df_popScope);
+		for (u8 c = 0;c < rs_instruction::instruction_count;c++) {
+			instruction_callback cb = inline_callback(rs_instruction(c));
+			if (cb) ctx->define_instruction(0, rs_instruction(c), cb);
+		}
 	}
 
 	void add_number_instruction_set(context* ctx) {
@@ -1278,28 +1304,10 @@ namespace rs {
 		};
 
 		for (u8 i = 0;i < 2;i++) {
-			rs_builtin_type type = number_types[i];
-			ctx->define_instruction(type, rs_instruction::add, num_add);
-			ctx->define_instruction(type, rs_instruction::sub, num_sub);
-			ctx->define_instruction(type, rs_instruction::mul, num_mul);
-			ctx->define_instruction(type, rs_instruction::div, num_div);
-			ctx->define_instruction(type, rs_instruction::mod, num_mod);
-			ctx->define_instruction(type, rs_instruction::pow, num_pow);
-			ctx->define_instruction(type, rs_instruction::less, num_less);
-			ctx->define_instruction(type, rs_instruction::greater, num_greater);
-			ctx->define_instruction(type, rs_instruction::compare, num_compare);
-
-			ctx->define_instruction(type, rs_instruction::addEq, num_addEq);
-			ctx->define_instruction(type, rs_instruction::subEq, num_subEq);
-			ctx->define_instruction(type, rs_instruction::mulEq, num_mulEq);
-			ctx->define_instruction(type, rs_instruction::divEq, num_divEq);
-			ctx->define_instruction(type, rs_instruction::modEq, num_modEq);
-			ctx->define_instruction(type, rs_instruction::powEq, num_powEq);
-			ctx->define_instruction(type, rs_instruction::lessEq, num_lessEq);
-			ctx->define_instruction(type, rs_instruction::greaterEq, num_greaterEq);
-
-			ctx->define_instruction(type, rs_instruction::inc, num_inc);
-			ctx->define_instruction(type, rs_instruction::dec, num_dec);
+			for (u8 c = 0;c < rs_instruction::instruction_count;c++) {
+				instruction_callback cb = number_callback(rs_instruction(c));
+				if (cb) ctx->define_instruction(number_types[i], rs_instruction(c), cb);
+			}
 		}
 	}
 
@@ -1319,4 +1327,133 @@ namespace rs {
 		ctx->define_instruction(rs_builtin_type::t_class, rs_instruction::prop, class_prop);
 		ctx->define_instruction(rs_builtin_type::t_class, rs_instruction::propAssign, class_propAssign);
 	}
+
+
+
+	#if (defined(__GNUC__) || defined(__clang__)) && !defined(SCRIPTS_SWITCH_DISPATCH)
+		#define SCRIPTS_COMPUTED_GOTO
+	#endif
+
+	// finds the handler for the type of the first argument, falling back to the
+	// default instruction set
+	inline void dispatch_typed(execution_state* state, const context::instruction_set* default_iset, instruction* i) {
+		context* ctx = state->ctx();
+		const context::instruction_set* iset = default_iset;
+		if (i->arg_count > 0) {
+			context_memory::slot* ba;
+			if (i->arg_is_register[0]) ba = ctx->memory->at(state->registers()[i->args[0].reg]);
+			else ba = ctx->memory->at(i->args[0].var);
+			iset = ctx->get_instruction_set(ba ? ba->type : 0);
+		}
+
+		instruction_callback icb = iset->callbacks[i->code];
+		if (!icb) icb = default_iset->callbacks[i->code];
+
+		if (icb) icb(state, i);
+		else {
+			throw runtime_exception(
+				"No instruction exists for this operation",
+				state
+			);
+		}
+	}
+
+	// whether the first operand of 'i' is a number
+	inline bool number_operand(execution_state* state, instruction* i) {
+		variable_id a_id = i->arg_is_register[0] ? state->registers()[i->args[0].reg] : i->args[0].var;
+		context_memory::slot* a = state->ctx()->memory->at(a_id);
+		return a && (a->type == rs_builtin_type::t_integer || a->type == rs_builtin_type::t_decimal);
+	}
+
+	void run_instructions(execution_state* state, integer_type exit_point) {
+		context* ctx = state->ctx();
+		instruction_array& iarr = *ctx->instructions;
+		const context::instruction_set* default_iset = ctx->get_instruction_set(0);
+		integer_type& iaddr = state->m_instruction_addr;
+		// operands are decoded from the packed instruction as it's fetched. handlers
+		// are given this copy, so they're unaffected if code is appended meanwhile
+		instruction decoded;
+		instruction* i = &decoded;
+
+		// instructions can skip the type lookup and be handled inline if no type
+		// overrides them and their default handler hasn't been replaced
+		bool is_inline[rs_instruction::instruction_count];
+		// number instructions skip it when their first operand is a number, as
+		// long as the builtin number handlers weren't replaced
+		bool is_number[rs_instruction::instruction_count];
+		const context::instruction_set* int_iset = ctx->get_instruction_set(rs_builtin_type::t_integer);
+		const context::instruction_set* dec_iset = ctx->get_instruction_set(rs_builtin_type::t_decimal);
+		for (u8 c = 0;c < rs_instruction::instruction_count;c++) {
+			rs_instruction code = rs_instruction(c);
+			instruction_callback cb = inline_callback(code);
+			is_inline[c] = cb && !ctx->is_type_specific(code) && default_iset->callbacks[c] == cb;
+
+			cb = number_callback(code);
+			is_number[c] = cb && int_iset->callbacks[c] == cb && dec_iset->callbacks[c] == cb;
+		}
+
+		auto fetch = [&]() {
+			state->m_current_instruction_idx = iaddr++;
+			state->m_executed_count++;
+			iarr.decode(state->m_current_instruction_idx, decoded);
+			#ifdef SCRIPTS_ENABLE_TRACE
+			if (state->m_trace_level != rs_trace_level::trace_none) state->trace_instruction(state->m_current_instruction_idx, *i);
+			#endif
+		};
+
+		#ifdef SCRIPTS_COMPUTED_GOTO
+			// each handler jumps straight to the next one's label
+			void* targets[rs_instruction::instruction_count];
+			for (u8 c = 0;c < rs_instruction::instruction_count;c++) targets[c] = &&typed;
+			targets[rs_instruction::null_instruction] = &&next;
+			#define op(code, handler) if (is_inline[rs_instruction::code]) targets[rs_instruction::code] = &&op_##code;
+			rs_inline_instructions(op)
+			#undef op
+			#define op(code, handler) if (is_number[rs_instruction::code]) targets[rs_instruction::code] = &&num_##code;
+			rs_number_instructions(op)
+			#undef op
+
+			next:
+			if (iaddr >= exit_point) return;
+			fetch();
+			goto *targets[i->code];
+
+			#define op(code, handler) op_##code: handler(state, i); goto next;
+			rs_inline_instructions(op)
+			#undef op
+
+			#define op(code, handler) num_##code: if (number_operand(state, i)) handler(state, i); else dispatch_typed(state, default_iset, i); goto next;
+			rs_number_instructions(op)
+			#undef op
+
+			typed:
+			dispatch_typed(state, default_iset, i);
+			goto next;
+		#else
+			while (iaddr < exit_point) {
+				fetch();
+				if (i->code == rs_instruction::null_instruction) continue;
+				if (is_number[i->code] && number_operand(state, i)) {
+					switch (i->code) {
+						#define op(code, handler) case rs_instruction::code: handler(state, i); break;
+						rs_number_instructions(op)
+						#undef op
+						default: break;
+					}
+					continue;
+				}
+				if (!is_inline[i->code]) {
+					dispatch_typed(state, default_iset, i);
+					continue;
+				}
+
+				switch (i->code) {
+					#define op(code, handler) case rs_instruction::code: handler(state, i); break;
+					rs_inline_instructions(op)
+					#undef op
+					default: break;
+				}
+			}
+		#endif
+	}
 };
\ No newline at end of file
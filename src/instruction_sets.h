@@ -3,9 +3,13 @@
 
 namespace rs {
 	class context;
+	class execution_state;
 	void add_default_instruction_set(context* ctx);
 	void add_number_instruction_set(context* ctx);
 	void add_object_instruction_set(context* ctx);
 	void add_string_instruction_set(context* ctx);
 	void add_class_instruction_set(context* ctx);
+
+	// executes instructions until the instruction address reaches exit_point
+	void run_instructions(execution_state* state, integer_type exit_point);
 };
\ No newline at end of file
@@ -1,109 +1,30 @@
 #include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include <execution_state.h>
 #include <context.h>
 #include <script_object.h>
 #include <script_function.h>
+#include <program.h>
+#include <trace.h>
 
 void print_instructions(const rs::context& ctx) {
-	const char* instructions[] = {
-		"null",
-		"store",
-		"newObj",
-		"addProto",
-		"prop",
-		"propAssign",
-		"move",
-		"add",
-		"sub",
-		"mul",
-		"div",
-		"mod",
-		"pow",
-		"or",
-		"and",
-		"less",
-		"greater",
-		"addEq",
-		"subEq",
-		"mulEq",
-		"divEq",
-		"modEq",
-		"powEq",
-		"orEq",
-		"andEq",
-		"lessEq",
-		"greaterEq",
-		"compare",
-		"inc",
-		"dec",
-		"branch",
-		"clearParams",
-		"call",
-		"jump",
-		"ret",
-		"pushState",
-		"popState",
-		"pushScope",
-		"popScope"
-	};
-	const char* registers[] = {
-		"null",
-		"this_obj",
-		"return_val",
-		"return_address",
-		"instruction_address",
-		"lvalue",
-		"rvalue",
-		"parameter0",
-		"parameter1",
-		"parameter2",
-		"parameter3",
-		"parameter4",
-		"parameter5",
-		"parameter6",
-		"parameter7",
-		"parameter_count"
-	};
-
 	printf("--- raw instructions ---\n");
 	for (int i = 0;i < ctx.instructions->count();i++) {
 		auto inst = (*ctx.instructions)[i];
-		printf("%d: %s", i, instructions[inst.code]);
+		printf("%d: %s", i, rs::instruction_name(inst.code));
 		for (int a = 0;a < inst.arg_count;a++) {
-			if (inst.arg_is_register[a]) printf(" $%s", registers[inst.args[a].reg]);
+			if (inst.arg_is_register[a]) printf(" $%s", rs::register_name(inst.args[a].reg));
+			else if (inst.arg_is_immediate[a]) printf(" @%lld", (long long)inst.args[a].imm);
 			else {
-				auto& v = ctx.memory->get(inst.args[a].var);
-				printf(" #%llu (%s)", inst.args[a].var, rs::var_tostring(v).c_str());
+				auto v = ctx.memory->get(inst.args[a].var);
+				printf(" #%llu (%s)", (unsigned long long)inst.args[a].var, rs::var_tostring(v).c_str());
 			}
 		}
 		printf("\n");
 	}
-
-	/*
-	printf("--- instructions with code ---\n");
-
-	int last_line = -1;
-	int last_col = -1;
-	for (int i = 0;i < ctx.instructions->count();i++) {
-	auto inst = (*ctx.instructions)[i];
-	auto src = ctx.instructions->instruction_source(i);
-	if (src.line != last_line || src.col != last_col) printf("\n\n%s\n", src.lineText.c_str());
-	last_line = src.line;
-	last_col = src.col;
-	for (int c = 0;c < int(src.col);c++) printf(" ");
-	printf("^ ");
-	printf(instructions[inst.code]);
-	for (int a = 0;a < inst.arg_count;a++) {
-	if (inst.arg_is_register[a]) printf(" $%s", registers[inst.args[a].reg]);
-	else {
-	auto& v = ctx.memory->get(inst.args[a].var);
-	printf(" #%llu (%s)", inst.args[a].var, var_to_string(v).c_str());
-	}
-	}
-	printf("\n");
-	}
-	*/
 }
 
 class test : public rs::script_object {
@@ -142,6 +63,227 @@ rs::variable_id test_func(rs::func_args* args) {
 }
 
 
+// runs the sample functions in a loop and reports how fast instructions are executed
+void benchmark(rs::context& ctx, const rs::context_parameters& p, rs::integer_type iterations) {
+	std::string code = rs::format("let i = 0; for (;i < %lld;i += 1) { x(1, 2, 3); }", (long long)iterations);
+	rs::integer_type entry = ctx.instructions->count();
+	if (!ctx.compiler->compile(code, *ctx.instructions)) return;
+
+	rs::execution_state es(p, &ctx);
+	auto start = std::chrono::high_resolution_clock::now();
+	try {
+		es.execute(entry);
+	} catch (const rs::runtime_exception& e) {
+		printf("%s\n", e.text.c_str());
+		return;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("%llu instructions in %.3f s (%.2f million instructions per second)\n", (unsigned long long)es.executed_count(), seconds, (es.executed_count() / seconds) / 1000000.0);
+}
+
+// compiles generated scripts of a quarter, half and all of 'lines' lines, each in a new
+// context, and reports how the compile time grows with the length of the script. it
+// fails if the time per line of the longest script is more than twice the shortest's
+bool compile_benchmark(rs::context_parameters& p, rs::integer_type lines) {
+	double first_per_line = 0.0;
+	double last_per_line = 0.0;
+	for (rs::integer_type div = 4;div >= 1;div /= 2) {
+		std::string code;
+		rs::integer_type line_count = 0;
+		for (rs::integer_type f = 0;line_count < lines / div;f++) {
+			long long n = (long long)f;
+			code += rs::format("function f%lld(a, b, c) {\n", n);
+			code += rs::format("\tlet d%lld = a + b * c;\n", n);
+			code += rs::format("\tconst e%lld = { x: d%lld, y: 2 };\n", n, n);
+			code += rs::format("\tfor (let i%lld = 0;i%lld < 10;i%lld += 1) { d%lld += e%lld.x - i%lld; }\n", n, n, n, n, n, n);
+			code += rs::format("\tif (d%lld > 100) { return d%lld / 2; }\n", n, n);
+			code += rs::format("\treturn d%lld;\n", n);
+			code += "}\n";
+			line_count += 7;
+		}
+
+		rs::context ctx(p);
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!ctx.add_code(code)) return false;
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		printf("%lld lines, %llu instructions compiled in %.3f s (%.0f lines per second)\n", (long long)line_count, (unsigned long long)ctx.instructions->count(), seconds, line_count / seconds);
+		last_per_line = seconds / line_count;
+		if (div == 4) first_per_line = last_per_line;
+	}
+
+	double growth = last_per_line / first_per_line;
+	printf("time per line grew %.2fx from a quarter to all of the lines\n", growth);
+	if (growth <= 2.0) return true;
+	printf("compile time grows faster than the length of the script\n");
+	return false;
+}
+
+// compiles a function once and calls it in a new context on each of 1, 2, 4... threads,
+// up to the number of cores, and reports how the throughput grows with the threads
+void thread_benchmark(rs::integer_type iterations) {
+	rs::context_parameters cp;
+	rs::context compiled(cp);
+	if (!compiled.add_code(
+		"function work(n) {"
+			"let acc = 0;"
+			"for (let i = 0;i < n;i += 1) { acc += i * 2 - 1; }"
+			"return acc;"
+		"}"
+	)) return;
+	const rs::program prog(&compiled, false);
+	if (!prog.valid()) return;
+
+	unsigned int cores = std::thread::hardware_concurrency();
+	if (cores == 0) cores = 1;
+	for (unsigned int thread_count = 1;thread_count <= cores;thread_count *= 2) {
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0;t < thread_count;t++) {
+			threads.emplace_back([&prog, iterations] {
+				rs::context_parameters p;
+				rs::context ctx(p);
+				if (!ctx.load_program(prog)) return;
+
+				for (rs::script_function* func : ctx.global_functions) {
+					if (func->name.text != "work") continue;
+					rs::variable_id arg = ctx.memory->set(rs::rs_builtin_type::t_integer, sizeof(rs::integer_type), (void*)&iterations);
+					rs::context_memory::mem_var result = {};
+					if (ctx.call_function(func, 0, &arg, 1, result)) ctx.release_result(result);
+				}
+			});
+		}
+		for (std::thread& t : threads) t.join();
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		double total = double(iterations) * thread_count;
+		printf("%u threads: %.0f iterations in %.3f s (%.2f million iterations per second)\n", thread_count, total, seconds, (total / seconds) / 1000000.0);
+	}
+}
+
+rs::variable_id nothing(rs::func_args*) {
+	return 0;
+}
+
+// adds two integers the way bindings did before typed bindings. its results are never
+// released, typed bindings store theirs in temporaries that are reused
+rs::variable_id untyped_add(rs::func_args* args) {
+	rs::integer_type a = *(rs::integer_type*)args->parameters.value(0).data;
+	rs::integer_type b = *(rs::integer_type*)args->parameters.value(1).data;
+	rs::integer_type result = a + b;
+	return args->context->memory->set(rs::rs_builtin_type::t_integer, sizeof(rs::integer_type), &result);
+}
+
+rs::integer_type typed_add(rs::integer_type a, rs::integer_type b) {
+	return a + b;
+}
+
+// calls bound functions from a script loop and reports how long each iteration takes.
+// the loops are compiled first and then run in turns for a few rounds, so that each
+// binding is measured under the same conditions, and the fastest round of each is kept.
+// the cost of a call is what an iteration takes more than one that calls 'nothing'
+void native_benchmark(rs::context& ctx, const rs::context_parameters& p, rs::integer_type iterations) {
+	ctx.bind_function("nothing", nothing);
+	ctx.bind_function("untyped_add", untyped_add);
+	ctx.bind_function<rs::integer_type(rs::integer_type, rs::integer_type)>("typed_add", typed_add);
+
+	const char* funcs[] = { "nothing", "untyped_add", "typed_add" };
+	const size_t func_count = sizeof(funcs) / sizeof(funcs[0]);
+	rs::integer_type entries[func_count];
+	rs::integer_type exits[func_count];
+	for (size_t f = 0;f < func_count;f++) {
+		const char* func = funcs[f];
+		std::string code = rs::format("let j_%s = 0; for (;j_%s < %lld;j_%s += 1) { %s(j_%s, 2); }", func, func, (long long)iterations, func, func, func);
+		entries[f] = ctx.instructions->count();
+		if (!ctx.compiler->compile(code, *ctx.instructions)) return;
+		exits[f] = ctx.instructions->count();
+	}
+
+	double best[func_count];
+	for (int round = 0;round < 5;round++) {
+		for (size_t f = 0;f < func_count;f++) {
+			rs::execution_state es(p, &ctx);
+			auto start = std::chrono::high_resolution_clock::now();
+			try {
+				es.execute(entries[f], exits[f]);
+			} catch (const rs::runtime_exception& e) {
+				printf("%s\n", e.text.c_str());
+				return;
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			if (round == 0 || seconds < best[f]) best[f] = seconds;
+		}
+	}
+
+	for (size_t f = 0;f < func_count;f++) {
+		printf("%s: %lld calls in %.3f s (%.0f ns per iteration)\n", funcs[f], (long long)iterations, best[f], (best[f] / iterations) * 1000000000.0);
+	}
+
+	double untyped = ((best[1] - best[0]) / iterations) * 1000000000.0;
+	double typed = ((best[2] - best[0]) / iterations) * 1000000000.0;
+	printf("typed_add takes %.1f ns per call, untyped_add %.1f ns (%.2fx)\n", typed, untyped, typed / untyped);
+}
+
+// calls a script function from c++ in a loop and reports how long each call takes
+void call_benchmark(rs::context& ctx, rs::integer_type iterations) {
+	rs::script_function* func = nullptr;
+	for (rs::script_function* f : ctx.global_functions) {
+		if (f->name.text == "t") func = f;
+	}
+	if (!func) return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (rs::integer_type i = 0;i < iterations;i++) {
+		rs::context_memory::mem_var result = {};
+		if (!ctx.call_function(func, 0, nullptr, 0, result)) return;
+		ctx.release_result(result);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("%lld calls in %.3f s (%.0f ns per call)\n", (long long)iterations, seconds, (seconds / iterations) * 1000000000.0);
+}
+
+// runs a loop 'iterations' times and then 100 times as many, and reports whether the
+// number of allocated variables grew with the number of iterations. the loop doesn't
+// create objects, those are only released once the collector's threshold is reached
+bool memory_test(rs::context& ctx, rs::integer_type iterations) {
+	if (!ctx.add_code(
+		"function step(a) { return a * 2; }\n"
+		"function churn(n) {"
+			"let acc = 0;"
+			"const s = 'abc';"
+			"for (let i = 0;i < n;i += 1) {"
+				"let str = s + i;"
+				"acc += step(i) - 1;"
+			"}"
+			"return acc;"
+		"}"
+	)) return false;
+
+	rs::script_function* func = nullptr;
+	for (rs::script_function* f : ctx.global_functions) {
+		if (f->name.text == "churn") func = f;
+	}
+	if (!func) return false;
+
+	rs::u64 marks[2] = { 0, 0 };
+	rs::integer_type counts[2] = { iterations, iterations * 100 };
+	for (int r = 0;r < 2;r++) {
+		rs::variable_id arg = ctx.memory->set(rs::rs_builtin_type::t_integer, sizeof(rs::integer_type), (void*)&counts[r]);
+		rs::context_memory::mem_var result = {};
+		if (!ctx.call_function(func, 0, &arg, 1, result)) return false;
+		ctx.release_result(result);
+		ctx.memory->deallocate(arg);
+		marks[r] = ctx.memory->high_water_mark();
+		printf("%lld iterations: %llu variables at most\n", (long long)counts[r], (unsigned long long)marks[r]);
+	}
+
+	if (marks[1] == marks[0]) return true;
+	printf("memory grew with the number of iterations\n");
+	return false;
+}
+
 int main(int arg_count, const char** args) {
 	for(int i = 0;i < arg_count;i++) {
 		printf("args[%d]: %s\n", i, args[i]);
@@ -172,6 +314,34 @@ int main(int arg_count, const char** args) {
 		"};\n"
 	);
 
+	if (arg_count > 1 && strcmp(args[1], "bench") == 0) {
+		benchmark(ctx, p, arg_count > 2 ? atoi(args[2]) : 100000);
+		return 0;
+	}
+
+	if (arg_count > 1 && strcmp(args[1], "compile") == 0) {
+		return compile_benchmark(p, arg_count > 2 ? atoi(args[2]) : 100000) ? 0 : 1;
+	}
+
+	if (arg_count > 1 && strcmp(args[1], "natives") == 0) {
+		native_benchmark(ctx, p, arg_count > 2 ? atoi(args[2]) : 1000000);
+		return 0;
+	}
+
+	if (arg_count > 1 && strcmp(args[1], "calls") == 0) {
+		call_benchmark(ctx, arg_count > 2 ? atoi(args[2]) : 1000000);
+		return 0;
+	}
+
+	if (arg_count > 1 && strcmp(args[1], "memory") == 0) {
+		return memory_test(ctx, arg_count > 2 ? atoi(args[2]) : 1000) ? 0 : 1;
+	}
+
+	if (arg_count > 1 && strcmp(args[1], "threads") == 0) {
+		thread_benchmark(arg_count > 2 ? atoi(args[2]) : 1000000);
+		return 0;
+	}
+
 	print_instructions(ctx);
 
 	printf("press enter to continue\n");
@@ -182,15 +352,13 @@ int main(int arg_count, const char** args) {
 	system("cls");
 	rs::context_memory::mem_var result = { 0 };
 	while (input[0] != 'q') {
-		result.data = nullptr;
-		result.size = 0;
-		result.type = 0;
 		memset(input, 0, 1024);
 		fgets(input, 1024, stdin);
 		system("cls");
 		std::string code = input;
 		ctx.execute(code, result);
 		printf("result: %s\n", var_tostring(result).c_str());
+		ctx.release_result(result);
 	}
 
 	return 0;
@@ -0,0 +1,878 @@
+#include <module.h>
+#include <context.h>
+#include <script_function.h>
+#include <prototype.h>
+#include <script_object.h>
+#include <stdio.h>
+using namespace std;
+
+namespace rs {
+	template <typename T>
+	void write_value(vector<u8>& out, const T& value) {
+		const u8* bytes = (const u8*)&value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// appends 'section' to 'out' at an 8 byte aligned offset and returns the offset
+	u64 write_section(vector<u8>& out, const u8* section, size_t size) {
+		while (out.size() % 8) out.push_back(0);
+		u64 offset = out.size();
+		out.insert(out.end(), section, section + size);
+		return offset;
+	}
+
+	bool module_error(const string& path, const string& error) {
+		printf("%s: %s\n", path.c_str(), error.c_str());
+		return false;
+	}
+
+	// reads the values of a section one after another. reading past the end of
+	// the file marks the reader as invalid and returns zeroes
+	class module_reader {
+		public:
+			module_reader(const vector<u8>& data, u64 offset) : m_data(&data), m_offset(offset) {
+				valid = offset <= data.size();
+			}
+
+			template <typename T>
+			T read() {
+				T value;
+				memset(&value, 0, sizeof(T));
+				if (!valid || m_data->size() - m_offset < sizeof(T)) {
+					valid = false;
+					return value;
+				}
+
+				memcpy(&value, m_data->data() + m_offset, sizeof(T));
+				m_offset += sizeof(T);
+				return value;
+			}
+
+			string read_string() {
+				u32 length = read<u32>();
+				if (!valid || m_data->size() - m_offset < length) {
+					valid = false;
+					return "";
+				}
+
+				string str((const char*)m_data->data() + m_offset, length);
+				m_offset += length;
+				return str;
+			}
+
+			bool valid;
+
+		protected:
+			const vector<u8>* m_data;
+			u64 m_offset;
+	};
+
+
+
+	bool write_module(context* ctx, vector<u8>& out, const string& module_name, bool heap) {
+		instruction_array& iarr = *ctx->instructions;
+
+		vector<string> strings;
+		munordered_map<string, u32> string_indices;
+		auto string_index = [&](const string& str) {
+			auto it = string_indices.find(str);
+			if (it != string_indices.end()) return it->second;
+			u32 idx = u32(strings.size());
+			strings.push_back(str);
+			string_indices[str] = idx;
+			return idx;
+		};
+		auto token = [&](const tokenizer::token& t) {
+			return module_token { string_index(t.text), string_index(t.file), t.line, t.col };
+		};
+
+		// variables that are declared by the code are given new ids when the
+		// module is loaded
+		munordered_map<variable_id, u32> local_indices;
+		auto local_index = [&](variable_id id) {
+			if (id == 0) return u32(0);
+			auto it = local_indices.find(id);
+			if (it != local_indices.end()) return it->second;
+			u32 idx = u32(local_indices.size() + 1);
+			local_indices[id] = idx;
+			return idx;
+		};
+
+		vector<script_function*> functions;
+		munordered_map<script_function*, u32> function_indices;
+		auto function_index = [&](script_function* func) {
+			auto it = function_indices.find(func);
+			if (it != function_indices.end()) return it->second;
+			u32 idx = u32(functions.size());
+			functions.push_back(func);
+			function_indices[func] = idx;
+			return idx;
+		};
+
+		// only the globals that the code refers to are written
+		munordered_map<variable_id, u32> context_globals;
+		for (u32 g = 0;g < ctx->global_variables.size();g++) context_globals[ctx->global_variables[g].id] = g;
+		vector<const variable*> globals;
+		munordered_map<variable_id, u32> global_indices;
+		auto global_index = [&](const variable& var) {
+			auto it = global_indices.find(var.id);
+			if (it != global_indices.end()) return it->second;
+			u32 idx = u32(globals.size());
+			globals.push_back(&var);
+			global_indices[var.id] = idx;
+			return idx;
+		};
+
+		munordered_map<variable_id, u32> prototype_indices;
+		for (u32 p = 0;p < ctx->prototypes.size();p++) prototype_indices[ctx->prototypes[p]->id()] = p;
+
+		// objects that belong to the host can't be written, they are found
+		// through a variable that was injected instead
+		vector<script_object*> objects;
+		munordered_map<script_object*, u32> object_indices;
+		auto object_index = [&](script_object* obj) {
+			auto it = object_indices.find(obj);
+			if (it != object_indices.end()) return it->second;
+			context_memory::slot* s = obj->id() ? ctx->memory->at(obj->id()) : nullptr;
+			if (!s || (s->flags & context_memory::sf_external)) return module_none;
+			u32 idx = u32(objects.size());
+			objects.push_back(obj);
+			object_indices[obj] = idx;
+			return idx;
+		};
+
+		// encodes the value of a static variable or, for snapshots, of any variable
+		auto encode = [&](context_memory::slot* s, module_constant& mc) {
+			mc.type = s->type;
+			if (s->type == rs_builtin_type::t_function) {
+				script_function* func = (script_function*)s->ptr;
+				if (func->cpp_callback) {
+					mc.kind = mc_bound_function;
+					mc.index = string_index(func->name.text);
+				} else {
+					mc.kind = mc_function;
+					mc.index = function_index(func);
+				}
+			} else if (s->type == rs_builtin_type::t_string) {
+				mc.kind = mc_string;
+				mc.index = string_index(string((const char*)s->ptr, s->size));
+			} else if (s->type == rs_builtin_type::t_class) {
+				auto proto = prototype_indices.find(((object_prototype*)s->ptr)->id());
+				if (proto == prototype_indices.end()) return false;
+				mc.kind = mc_prototype;
+				mc.index = proto->second;
+			} else if (s->type == rs_builtin_type::t_object && heap) {
+				mc.kind = mc_object;
+				mc.index = object_index((script_object*)s->ptr);
+				if (mc.index == module_none) return false;
+			} else if (!type_is_ptr(s->type) && !(s->flags & context_memory::sf_external)) {
+				mc.kind = mc_value;
+				mc.index = s->size;
+				memcpy(&mc.value, s->bytes, sizeof(mc.value));
+			} else return false;
+			return true;
+		};
+
+		vector<module_constant> constants(iarr.constant_count());
+		memset(constants.data(), 0, constants.size() * sizeof(module_constant));
+		for (u32 c = 1;c < constants.size();c++) {
+			module_constant& mc = constants[c];
+			variable_id id = iarr.constant(c);
+
+			auto global = context_globals.find(id);
+			if (global != context_globals.end()) {
+				mc.kind = mc_global;
+				mc.index = global_index(ctx->global_variables[global->second]);
+				continue;
+			}
+
+			auto proto = prototype_indices.find(id);
+			if (proto != prototype_indices.end()) {
+				mc.kind = mc_prototype;
+				mc.index = proto->second;
+				continue;
+			}
+
+			// functions, numbers and strings created by the compiler are static,
+			// other variables only get a value while the code runs
+			context_memory::slot* s = ctx->memory->at(id);
+			if (!s || !(s->flags & context_memory::sf_static)) {
+				mc.kind = mc_local;
+				mc.index = local_index(id);
+				continue;
+			}
+
+			if (!encode(s, mc)) return module_error(module_name, format("Constant of type %d can't be written to a module", s->type));
+		}
+
+		vector<u8> prototypes;
+		for (object_prototype* proto : ctx->prototypes) {
+			mvector<atom_id> methods = proto->method_names();
+			mvector<atom_id> static_methods = proto->static_method_names();
+			mvector<atom_id> static_vars = proto->static_variable_names();
+
+			module_prototype mp;
+			mp.declaration = token(proto->declaration());
+			mp.constructor = proto->constructor() ? function_index(proto->constructor()) : module_none;
+			mp.method_count = u32(methods.size());
+			mp.static_method_count = u32(static_methods.size());
+			mp.static_var_count = u32(static_vars.size());
+			write_value(prototypes, mp);
+
+			for (atom_id name : methods) write_value(prototypes, function_index(proto->method(name)));
+			for (atom_id name : static_methods) write_value(prototypes, function_index(proto->static_method(name)));
+			for (atom_id name : static_vars) {
+				write_value(prototypes, string_index(ctx->atoms->str(name)));
+				write_value(prototypes, local_index(proto->static_variable(name)));
+			}
+		}
+
+		// values are encoded before the functions, so that the functions they
+		// refer to are written as well
+		vector<module_constant> values;
+		vector<u8> object_data;
+		if (heap) {
+			auto value = [&](variable_id id, module_constant& mc) {
+				memset(&mc, 0, sizeof(module_constant));
+				context_memory::slot* s = ctx->memory->at(id);
+				// variables that were injected by the host are bound to it again when loading
+				if (!s || !(s->flags & context_memory::sf_allocated) || (s->flags & context_memory::sf_external)) return true;
+				if (encode(s, mc)) return true;
+
+				if (s->type == rs_builtin_type::t_object) module_error(module_name, "Objects that belong to the host can't be written to a snapshot");
+				else module_error(module_name, format("Value of type %d can't be written to a snapshot", s->type));
+				return false;
+			};
+
+			vector<variable_id> local_ids(local_indices.size() + 1, 0);
+			for (auto& l : local_indices) local_ids[l.second] = l.first;
+
+			values.resize(globals.size() + local_ids.size() - 1);
+			for (u32 g = 0;g < globals.size();g++) {
+				if (!value(globals[g]->id, values[g])) return false;
+			}
+			for (u32 l = 1;l < local_ids.size();l++) {
+				if (!value(local_ids[l], values[globals.size() + l - 1])) return false;
+			}
+
+			// properties can add more objects
+			for (u32 o = 0;o < objects.size();o++) {
+				script_object* obj = objects[o];
+				vector<script_object::prop> props = obj->properties();
+
+				module_object mo;
+				mo.prototype = module_none;
+				if (obj->prototype) {
+					auto proto = prototype_indices.find(obj->prototype->id());
+					if (proto != prototype_indices.end()) mo.prototype = proto->second;
+				}
+				mo.property_count = u32(props.size());
+				write_value(object_data, mo);
+
+				for (const script_object::prop& p : props) {
+					module_constant mc;
+					if (!value(p.id, mc)) return false;
+					write_value(object_data, string_index(p.name));
+					write_value(object_data, mc);
+				}
+			}
+		}
+
+		vector<u8> function_data;
+		for (script_function* func : functions) {
+			module_function mf;
+			mf.name = token(func->name);
+			mf.entry_point = u32(func->entry_point);
+			mf.instruction_count = u32(func->exit_point - func->entry_point);
+			mf.is_global = 0;
+			for (script_function* global : ctx->global_functions) mf.is_global |= global == func;
+			mf.param_count = u8(func->params.size());
+			mf.unused = 0;
+			mf.declared_var_count = u32(func->declared_vars.size());
+			write_value(function_data, mf);
+
+			for (const variable& param : func->params) {
+				write_value(function_data, module_param { token(param.name), local_index(param.id), param.is_const });
+			}
+			for (size_t d = 0;d < func->declared_vars.size();d++) write_value(function_data, local_index(*func->declared_vars[d]));
+		}
+
+		vector<u8> global_data;
+		for (const variable* var : globals) write_value(global_data, module_global { token(var->name), var->is_const });
+
+		vector<u8> caches;
+		for (u32 c = 0;c < iarr.cache_count();c++) write_value(caches, string_index(ctx->atoms->str(iarr.cache(c).name)));
+
+		// locals that only the functions declare have no value
+		if (heap) {
+			module_constant none;
+			memset(&none, 0, sizeof(module_constant));
+			values.resize(globals.size() + local_indices.size(), none);
+		}
+
+		vector<u8> sources;
+		for (u32 s = 0;s < iarr.source_count();s++) {
+			write_value(sources, string_index(iarr.source_file(s)));
+			write_value(sources, string_index(iarr.source_code(s)));
+		}
+
+		// every string has been added by now
+		vector<u8> string_data;
+		for (const string& str : strings) {
+			write_value(string_data, u32(str.length()));
+			string_data.insert(string_data.end(), str.begin(), str.end());
+		}
+
+		module_header header;
+		memset(&header, 0, sizeof(module_header));
+		header.magic = module_magic;
+		header.version = module_version;
+		header.integer_size = sizeof(integer_type);
+		header.decimal_size = sizeof(decimal_type);
+		header.instruction_size = sizeof(instruction_array::encoded_instruction);
+		header.has_heap = heap;
+		header.instruction_count = u32(iarr.count());
+		header.constant_count = u32(constants.size());
+		header.string_count = u32(strings.size());
+		header.function_count = u32(functions.size());
+		header.prototype_count = u32(ctx->prototypes.size());
+		header.global_count = u32(globals.size());
+		header.local_count = u32(local_indices.size());
+		header.cache_count = iarr.cache_count();
+		header.source_count = iarr.source_count();
+		header.object_count = u32(objects.size());
+
+		out.assign(sizeof(module_header), 0);
+		const u8* instructions = iarr.count() ? (const u8*)&iarr.encoded(0) : nullptr;
+		const u8* source_map = iarr.count() ? (const u8*)&iarr.location(0) : nullptr;
+		header.instructions = write_section(out, instructions, iarr.count() * sizeof(instruction_array::encoded_instruction));
+		header.source_map = write_section(out, source_map, iarr.count() * sizeof(instruction_array::source_location));
+		header.constants = write_section(out, (const u8*)constants.data(), constants.size() * sizeof(module_constant));
+		header.strings = write_section(out, string_data.data(), string_data.size());
+		header.functions = write_section(out, function_data.data(), function_data.size());
+		header.prototypes = write_section(out, prototypes.data(), prototypes.size());
+		header.globals = write_section(out, global_data.data(), global_data.size());
+		header.caches = write_section(out, caches.data(), caches.size());
+		header.sources = write_section(out, sources.data(), sources.size());
+		if (heap) {
+			header.values = write_section(out, (const u8*)values.data(), values.size() * sizeof(module_constant));
+			header.objects = write_section(out, object_data.data(), object_data.size());
+		}
+		memcpy(out.data(), &header, sizeof(module_header));
+		return true;
+	}
+
+	bool write_module(context* ctx, const string& path, bool heap) {
+		vector<u8> out;
+		if (!write_module(ctx, out, path, heap)) return false;
+
+		FILE* fp = fopen(path.c_str(), "wb");
+		if (!fp) return module_error(path, "Module file could not be opened for writing");
+		bool written = fwrite(out.data(), 1, out.size(), fp) == out.size();
+		fclose(fp);
+
+		if (!written) return module_error(path, "Module file could not be written");
+		return true;
+	}
+
+
+
+	bool read_module_file(const string& path, vector<u8>& data) {
+		FILE* fp = fopen(path.c_str(), "rb");
+		if (!fp) return module_error(path, "Module file could not be opened");
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		if (size > 0) {
+			data.resize(size_t(size));
+			if (fread(data.data(), 1, data.size(), fp) != data.size()) {
+				fclose(fp);
+				data.clear();
+				return module_error(path, "Module file could not be read");
+			}
+		}
+		fclose(fp);
+		return true;
+	}
+
+	bool read_module(context* ctx, const string& path, bool heap) {
+		vector<u8> data;
+		if (!read_module_file(path, data)) return false;
+		return read_module(ctx, data, path, heap);
+	}
+
+	bool read_module(context* ctx, const vector<u8>& data, const string& module_name, bool heap) {
+		module_image image;
+		if (!read_module_image(data, module_name, image)) return false;
+		return load_module_image(ctx, image, heap, false);
+	}
+
+	bool read_module_image(const vector<u8>& data, const string& module_name, module_image& image) {
+		module_header header;
+		if (data.size() < sizeof(module_header)) return module_error(module_name, "File is not a module");
+		memcpy(&header, data.data(), sizeof(module_header));
+		if (header.magic != module_magic) return module_error(module_name, "File is not a module");
+		if (header.version != module_version) {
+			return module_error(module_name, format("Module version %u is not supported, expected version %u", header.version, module_version));
+		}
+		if (
+			header.integer_size != sizeof(integer_type) ||
+			header.decimal_size != sizeof(decimal_type) ||
+			header.instruction_size != sizeof(instruction_array::encoded_instruction)
+		) {
+			return module_error(module_name, "Module was compiled with different integer, decimal or instruction sizes");
+		}
+
+		// counts can't be larger than the records that are left in their sections.
+		// they're checked before anything is allocated for them
+		auto fits = [&data](u64 offset, u64 count, u64 record_size) {
+			return offset <= data.size() && count * record_size <= data.size() - offset;
+		};
+		if (
+			!fits(header.strings, header.string_count, sizeof(u32)) ||
+			!fits(header.constants, header.constant_count, sizeof(module_constant)) ||
+			!fits(header.functions, header.function_count, sizeof(module_function)) ||
+			!fits(header.prototypes, header.prototype_count, sizeof(module_prototype)) ||
+			!fits(header.globals, header.global_count, sizeof(module_global)) ||
+			!fits(header.caches, header.cache_count, sizeof(u32)) ||
+			!fits(header.sources, header.source_count, sizeof(u32) * 2) ||
+			(header.has_heap && !fits(header.values, u64(header.global_count) + header.local_count, sizeof(module_constant))) ||
+			(header.has_heap && !fits(header.objects, header.object_count, sizeof(module_object)))
+		) {
+			return module_error(module_name, "Module is corrupt");
+		}
+
+		// everything is read and checked before anything is added to the context
+		bool valid = true;
+		auto check = [&valid](bool condition) {
+			valid = valid && condition;
+			return condition;
+		};
+
+		vector<string>& strings = image.strings;
+		module_reader r(data, header.strings);
+		for (u32 s = 0;s < header.string_count && r.valid;s++) strings.push_back(r.read_string());
+		check(r.valid);
+
+		auto str = [&](u32 idx) -> const string& {
+			static const string none;
+			return check(idx < strings.size()) ? strings[idx] : none;
+		};
+		auto token = [&](const module_token& t) {
+			tokenizer::token out;
+			out.text = str(t.text);
+			out.file = str(t.file);
+			out.line = t.line;
+			out.col = t.col;
+			return out;
+		};
+
+		vector<module_constant>& constants = image.constants;
+		r = module_reader(data, header.constants);
+		for (u32 c = 0;c < header.constant_count && r.valid;c++) constants.push_back(r.read<module_constant>());
+		check(r.valid && constants.size() > 0);
+
+		vector<loaded_function>& functions = image.functions;
+		functions.resize(header.function_count);
+		r = module_reader(data, header.functions);
+		for (loaded_function& f : functions) {
+			f.info = r.read<module_function>();
+			for (u8 p = 0;p < f.info.param_count && r.valid;p++) f.params.push_back(r.read<module_param>());
+			for (u32 d = 0;d < f.info.declared_var_count && r.valid;d++) f.declared_vars.push_back(r.read<u32>());
+			if (!r.valid) break;
+
+			check(u64(f.info.entry_point) + f.info.instruction_count <= header.instruction_count);
+			for (const module_param& p : f.params) check(p.local <= header.local_count);
+			for (u32 d : f.declared_vars) check(d <= header.local_count);
+		}
+		check(r.valid);
+
+		vector<loaded_prototype>& prototypes = image.prototypes;
+		prototypes.resize(header.prototype_count);
+		r = module_reader(data, header.prototypes);
+		for (loaded_prototype& p : prototypes) {
+			p.info = r.read<module_prototype>();
+			for (u32 m = 0;m < p.info.method_count && r.valid;m++) p.methods.push_back(r.read<u32>());
+			for (u32 m = 0;m < p.info.static_method_count && r.valid;m++) p.static_methods.push_back(r.read<u32>());
+			for (u32 v = 0;v < p.info.static_var_count && r.valid;v++) {
+				u32 name = r.read<u32>();
+				p.static_vars.push_back({ name, r.read<u32>() });
+			}
+			if (!r.valid) break;
+
+			check(p.info.constructor == module_none || p.info.constructor < header.function_count);
+			for (u32 m : p.methods) check(m < header.function_count);
+			for (u32 m : p.static_methods) check(m < header.function_count);
+			for (auto& v : p.static_vars) check(v.second <= header.local_count);
+		}
+		check(r.valid);
+
+		// every local is referred to by a constant, a parameter, a declared
+		// variable or a static variable
+		u64 local_refs = constants.size();
+		for (const loaded_function& f : functions) local_refs += f.params.size() + f.declared_vars.size();
+		for (const loaded_prototype& p : prototypes) local_refs += p.static_vars.size();
+		check(header.local_count <= local_refs);
+
+		vector<module_global>& globals = image.globals;
+		r = module_reader(data, header.globals);
+		for (u32 g = 0;g < header.global_count && r.valid;g++) globals.push_back(r.read<module_global>());
+		check(r.valid);
+
+		vector<u32>& caches = image.caches;
+		r = module_reader(data, header.caches);
+		for (u32 c = 0;c < header.cache_count && r.valid;c++) caches.push_back(r.read<u32>());
+		check(r.valid);
+
+		vector<pair<u32, u32>> sources;
+		r = module_reader(data, header.sources);
+		for (u32 s = 0;s < header.source_count && r.valid;s++) {
+			u32 file = r.read<u32>();
+			sources.push_back({ file, r.read<u32>() });
+		}
+		check(r.valid);
+
+		vector<module_constant>& values = image.values;
+		vector<loaded_object>& objects = image.objects;
+		if (header.has_heap) {
+			r = module_reader(data, header.values);
+			for (u64 v = 0;v < u64(header.global_count) + header.local_count && r.valid;v++) values.push_back(r.read<module_constant>());
+			check(r.valid);
+
+			r = module_reader(data, header.objects);
+			for (u32 o = 0;o < header.object_count && r.valid;o++) {
+				loaded_object obj;
+				obj.info = r.read<module_object>();
+				for (u32 p = 0;p < obj.info.property_count && r.valid;p++) {
+					u32 name = r.read<u32>();
+					obj.properties.push_back({ name, r.read<module_constant>() });
+				}
+				check(obj.info.prototype == module_none || obj.info.prototype < header.prototype_count);
+				objects.push_back(obj);
+			}
+			check(r.valid);
+		}
+
+		// values of variables and properties, in the order they are assigned
+		vector<const module_constant*> heap_values;
+		for (const module_constant& v : values) heap_values.push_back(&v);
+		for (const loaded_object& o : objects) {
+			for (auto& p : o.properties) heap_values.push_back(&p.second);
+		}
+
+		// the instructions and source map are copied out of 'data' as they are,
+		// then checked
+		u64 instructions_size = u64(header.instruction_count) * sizeof(instruction_array::encoded_instruction);
+		u64 source_map_size = u64(header.instruction_count) * sizeof(instruction_array::source_location);
+		check(header.instructions <= data.size() && data.size() - header.instructions >= instructions_size);
+		check(header.source_map <= data.size() && data.size() - header.source_map >= source_map_size);
+		if (!valid) return module_error(module_name, "Module is corrupt");
+
+		image.instructions.resize(header.instruction_count);
+		image.source_map.resize(header.instruction_count);
+		if (header.instruction_count > 0) {
+			memcpy(image.instructions.data(), data.data() + header.instructions, size_t(instructions_size));
+			memcpy(image.source_map.data(), data.data() + header.source_map, size_t(source_map_size));
+		}
+
+		for (u32 i = 0;i < header.instruction_count;i++) {
+			const instruction_array::encoded_instruction& e = image.instructions[i];
+			const instruction_array::source_location& loc = image.source_map[i];
+			check(e.code < rs_instruction::instruction_count && (e.operand_info >> 6) <= 3 && loc.source < header.source_count);
+			for (u8 a = 0;a < (e.operand_info >> 6);a++) {
+				u8 kind = (e.operand_info >> (a * 2)) & 3;
+				u32 operand = e.operands[a];
+				if (kind == instruction_array::ok_variable) check(operand < header.constant_count);
+				else if (kind == instruction_array::ok_register) check(operand < rs_register::register_count);
+				else if (kind == instruction_array::ok_immediate) {
+					if (e.code == rs_instruction::jump || e.code == rs_instruction::branch) check(operand <= header.instruction_count);
+					else if (e.code == rs_instruction::prop || e.code == rs_instruction::propAssign) check(operand < header.cache_count);
+				} else check(false);
+			}
+		}
+
+		for (const module_constant& c : constants) {
+			switch (c.kind) {
+				case mc_null: break;
+				case mc_value: check(c.index <= sizeof(c.value) && !type_is_ptr(c.type)); break;
+				case mc_string: str(c.index); break;
+				case mc_function: check(c.index < header.function_count); break;
+				case mc_bound_function: str(c.index); break;
+				case mc_prototype: check(c.index < header.prototype_count); break;
+				case mc_global: check(c.index < header.global_count); break;
+				case mc_local: check(c.index > 0 && c.index <= header.local_count); break;
+				default: check(false); break;
+			}
+		}
+
+		for (const module_constant* v : heap_values) {
+			switch (v->kind) {
+				case mc_null: break;
+				case mc_value: check(v->index <= sizeof(v->value) && !type_is_ptr(v->type)); break;
+				case mc_string: str(v->index); break;
+				case mc_function: check(v->index < header.function_count); break;
+				case mc_bound_function: str(v->index); break;
+				case mc_prototype: check(v->index < header.prototype_count); break;
+				case mc_object: check(v->index < header.object_count); break;
+				default: check(false); break;
+			}
+		}
+
+		for (const module_global& g : globals) token(g.name);
+		for (const loaded_function& f : functions) {
+			token(f.info.name);
+			for (const module_param& p : f.params) token(p.name);
+		}
+		for (const loaded_prototype& p : prototypes) {
+			token(p.info.declaration);
+			for (auto& v : p.static_vars) str(v.first);
+		}
+		for (const loaded_object& o : objects) {
+			for (auto& p : o.properties) str(p.first);
+		}
+		for (u32 c : caches) str(c);
+		for (auto& s : sources) {
+			str(s.first);
+			str(s.second);
+		}
+		if (!valid) return module_error(module_name, "Module is corrupt");
+
+		for (auto& s : sources) image.sources.push_back({ s.first, make_shared<const string>(strings[s.second]) });
+		image.name = module_name;
+		image.header = header;
+		return true;
+	}
+
+	bool load_module_image(context* ctx, const module_image& image, bool heap, bool shared) {
+		const module_header& header = image.header;
+		const string& module_name = image.name;
+		const vector<string>& strings = image.strings;
+		const vector<module_constant>& constants = image.constants;
+		const vector<loaded_function>& functions = image.functions;
+		const vector<loaded_prototype>& prototypes = image.prototypes;
+		const vector<module_global>& globals = image.globals;
+		const vector<module_constant>& values = image.values;
+		const vector<loaded_object>& objects = image.objects;
+		if (heap && !header.has_heap) return module_error(module_name, "Module is not a snapshot");
+
+		// every index was checked when the image was read
+		auto str = [&strings](u32 idx) -> const string& {
+			return strings[idx];
+		};
+		auto token = [&](const module_token& t) {
+			tokenizer::token out;
+			out.text = str(t.text);
+			out.file = str(t.file);
+			out.line = t.line;
+			out.col = t.col;
+			return out;
+		};
+
+		// names the module declares must not exist yet, c++ functions it calls must
+		for (const loaded_function& f : functions) {
+			if (!f.info.is_global) continue;
+			const string& name = str(f.info.name.text);
+			for (script_function* existing : ctx->global_functions) {
+				if (existing->name.text == name) return module_error(module_name, format("Cannot redeclare '%s'", name.c_str()));
+			}
+		}
+
+		for (const loaded_prototype& p : prototypes) {
+			const string& name = str(p.info.declaration.text);
+			for (object_prototype* existing : ctx->prototypes) {
+				if (existing->name() == name) return module_error(module_name, format("Cannot redeclare '%s'", name.c_str()));
+			}
+		}
+
+		auto bound_function = [ctx](const string& name) {
+			script_function* func = nullptr;
+			for (script_function* existing : ctx->global_functions) {
+				if (existing->cpp_callback && existing->name.text == name) func = existing;
+			}
+			return func;
+		};
+
+		vector<script_function*> bound_functions(constants.size(), nullptr);
+		for (u32 c = 0;c < constants.size();c++) {
+			if (constants[c].kind != mc_bound_function) continue;
+			const string& name = str(constants[c].index);
+			bound_functions[c] = bound_function(name);
+			if (!bound_functions[c]) return module_error(module_name, format("Module calls '%s', which is not bound", name.c_str()));
+		}
+
+		if (heap) {
+			vector<const module_constant*> heap_values;
+			for (const module_constant& v : values) heap_values.push_back(&v);
+			for (const loaded_object& o : objects) {
+				for (auto& p : o.properties) heap_values.push_back(&p.second);
+			}
+
+			for (const module_constant* v : heap_values) {
+				if (v->kind != mc_bound_function) continue;
+				const string& name = str(v->index);
+				if (!bound_function(name)) return module_error(module_name, format("Module refers to '%s', which is not bound", name.c_str()));
+			}
+		}
+
+
+
+		instruction_array& iarr = *ctx->instructions;
+		// in a context that hasn't compiled anything the instructions don't need
+		// to be offset, so a shared image's instructions can be used as they are
+		bool share = shared && header.instruction_count > 0 && iarr.count() == 0 && iarr.constant_count() == 1 && iarr.cache_count() == 0 && iarr.source_count() == 0;
+		integer_type base = integer_type(iarr.count());
+		u32 cache_base = iarr.cache_count();
+		iarr.backup();
+
+		vector<u32> source_ids;
+		for (const loaded_source& s : image.sources) source_ids.push_back(iarr.add_source(str(s.file), s.code));
+
+		// what the context had, so a module that fails to load can be taken out again
+		context::declarations declared = ctx->declared();
+
+		vector<variable_id> locals(header.local_count + 1, 0);
+		for (u32 l = 1;l < locals.size();l++) locals[l] = ctx->memory->gen_var_id();
+
+		// globals with a name that the context already has refer to that global
+		vector<variable_id> global_ids;
+		for (const module_global& g : globals) {
+			tokenizer::token name = token(g.name);
+			variable_id id = 0;
+			for (const variable& existing : ctx->global_variables) {
+				if (existing.name.text == name.text) id = existing.id;
+			}
+
+			if (!id) {
+				id = ctx->memory->gen_var_id();
+				ctx->global_variables.push_back({ id, name, g.is_const != 0 });
+			}
+			global_ids.push_back(id);
+		}
+
+		vector<script_function*> function_ptrs;
+		for (const loaded_function& f : functions) {
+			integer_type entry = base + integer_type(f.info.entry_point);
+			variable_id entry_id = ctx->memory->set_static(rs_builtin_type::t_integer, sizeof(integer_type), &entry);
+			auto func = new script_function(ctx, token(f.info.name), entry_id, f.info.instruction_count);
+			func->function_id = ctx->memory->set_static(rs_builtin_type::t_function, sizeof(script_function*), func);
+			for (const module_param& p : f.params) func->params.push_back({ locals[p.local], token(p.name), p.is_const != 0 });
+			for (u32 d : f.declared_vars) func->declared_vars.push(locals[d]);
+			if (f.info.is_global) ctx->global_functions.push_back(func);
+			function_ptrs.push_back(func);
+		}
+
+		vector<object_prototype*> prototype_ptrs;
+		for (const loaded_prototype& p : prototypes) {
+			auto proto = new object_prototype(ctx, token(p.info.declaration));
+			if (p.info.constructor != module_none) proto->constructor(function_ptrs[p.info.constructor]);
+			for (u32 m : p.methods) proto->method(function_ptrs[m]);
+			for (u32 m : p.static_methods) proto->static_method(function_ptrs[m]);
+			for (auto& v : p.static_vars) proto->static_variable(str(v.first), locals[v.second]);
+			ctx->prototypes.push_back(proto);
+			prototype_ptrs.push_back(proto);
+		}
+
+		vector<variable_id> pool(constants.size(), 0);
+		for (u32 c = 0;c < constants.size();c++) {
+			const module_constant& mc = constants[c];
+			switch (mc.kind) {
+				case mc_value: {
+					pool[c] = ctx->memory->set_static(mc.type, mc.index, (void*)&mc.value);
+					break;
+				}
+				case mc_string: pool[c] = ctx->atoms->variable(ctx->atoms->get(str(mc.index))); break;
+				case mc_function: pool[c] = function_ptrs[mc.index]->function_id; break;
+				case mc_bound_function: pool[c] = bound_functions[c]->function_id; break;
+				case mc_prototype: pool[c] = prototype_ptrs[mc.index]->id(); break;
+				case mc_global: pool[c] = global_ids[mc.index]; break;
+				case mc_local: pool[c] = locals[mc.index]; break;
+				default: break;
+			}
+		}
+
+		for (u32 c : image.caches) iarr.add_property_cache(ctx->atoms->get(str(c)));
+
+		try {
+			if (share) iarr.share(image.instructions.data(), image.source_map.data(), image.instructions.size(), pool);
+			else {
+				for (u32 i = 0;i < header.instruction_count;i++) {
+					const instruction_array::encoded_instruction& e = image.instructions[i];
+					const instruction_array::source_location& loc = image.source_map[i];
+
+					// jump targets and property caches are offset by what the context
+					// already had
+					integer_type imm_base = 0;
+					if (e.code == rs_instruction::jump || e.code == rs_instruction::branch) imm_base = base;
+					else if (e.code == rs_instruction::prop || e.code == rs_instruction::propAssign) imm_base = cache_base;
+
+					instruction_array::instruction inst((rs_instruction)e.code);
+					for (u8 a = 0;a < (e.operand_info >> 6);a++) {
+						u8 kind = (e.operand_info >> (a * 2)) & 3;
+						if (kind == instruction_array::ok_register) inst.arg((rs_register)e.operands[a]);
+						else if (kind == instruction_array::ok_immediate) inst.imm(imm_base + integer_type(e.operands[a]));
+						else inst.arg(pool[e.operands[a]]);
+					}
+
+					iarr.append(inst, source_ids[loc.source], loc.line, loc.col);
+				}
+			}
+		} catch (const parse_exception& e) {
+			printf("%s:%d:%d: %s\n%s\n", e.file.c_str(), e.line + 1, e.col + 1, e.text.c_str(), e.lineText.c_str());
+			iarr.restore();
+
+			// none of the module's code ran, so nothing can refer to what it declared
+			ctx->undeclare(declared);
+			for (object_prototype* proto : prototype_ptrs) {
+				ctx->memory->deallocate(proto->id());
+				delete proto;
+			}
+			for (script_function* func : function_ptrs) {
+				// static variables can't be deallocated, they're left empty
+				ctx->memory->set(func->function_id, rs_builtin_type::t_null, 0, nullptr);
+				delete func;
+			}
+			return false;
+		}
+
+		if (heap) {
+			vector<script_object*> object_ptrs;
+			for (const loaded_object& o : objects) {
+				auto obj = new script_object(ctx);
+				obj->set_id(ctx->memory->set(rs_builtin_type::t_object, sizeof(script_object*), obj));
+				ctx->gc->track(obj, true);
+				if (o.info.prototype != module_none) obj->add_prototype(prototype_ptrs[o.info.prototype], false, nullptr, 0);
+				object_ptrs.push_back(obj);
+			}
+
+			auto set_value = [&](variable_id id, const module_constant& v) {
+				switch (v.kind) {
+					case mc_value: ctx->memory->set(id, v.type, v.index, (void*)&v.value); break;
+					case mc_string: {
+						const string& text = str(v.index);
+						char* data = new char[text.length()];
+						memcpy(data, text.c_str(), text.length());
+						ctx->memory->set(id, rs_builtin_type::t_string, text.length(), data);
+						break;
+					}
+					case mc_function: ctx->memory->set(id, rs_builtin_type::t_function, sizeof(script_function*), function_ptrs[v.index]); break;
+					case mc_bound_function: ctx->memory->set(id, rs_builtin_type::t_function, sizeof(script_function*), bound_function(str(v.index))); break;
+					case mc_prototype: ctx->memory->set(id, rs_builtin_type::t_class, sizeof(object_prototype*), prototype_ptrs[v.index]); break;
+					case mc_object: ctx->memory->set(id, rs_builtin_type::t_object, sizeof(script_object*), object_ptrs[v.index]); break;
+					default: break;
+				}
+			};
+
+			for (u32 g = 0;g < global_ids.size();g++) set_value(global_ids[g], values[g]);
+			for (u32 l = 1;l < locals.size();l++) set_value(locals[l], values[global_ids.size() + l - 1]);
+			for (u32 o = 0;o < objects.size();o++) {
+				for (auto& p : objects[o].properties) {
+					variable_id id = object_ptrs[o]->define_property(str(p.first), rs_builtin_type::t_null, 0, nullptr);
+					set_value(id, p.second);
+				}
+			}
+		}
+
+		iarr.commit();
+		return true;
+	}
+};
\ No newline at end of file
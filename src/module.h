@@ -0,0 +1,231 @@
+#pragma once
+#include <defs.h>
+#include <instruction_array.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace rs {
+	class context;
+
+	// a module is everything that a context has compiled, written to a file so
+	// another context can load it without parsing the code again. it holds the
+	// instructions, the constants they refer to, the functions, prototypes,
+	// globals and property caches that were compiled and the code that they
+	// were compiled from.
+	//
+	// the file starts with a module_header. the instructions and the source
+	// map are stored the same way the instruction array stores them, at 8 byte
+	// aligned offsets. the loader copies them into its instruction array,
+	// rebasing their operands on the way, because the constants, jump targets
+	// and property caches that they refer to depend on what the loading
+	// context already has. the other sections only refer to each other by
+	// index.
+	//
+	// a snapshot is a module that also has a heap section, the values that its
+	// variables had when it was written and the objects that they refer to. it
+	// is loaded without running the top level code again
+	static const u32 module_magic = 0x4d535223; // "#RSM"
+	// changes whenever the layout of the file or the encoding of instructions changes
+	static const u32 module_version = 2;
+
+	struct module_header {
+		u32 magic;
+		u32 version;
+		// sizes that the module was compiled with, they must match the loader's
+		u8 integer_size;
+		u8 decimal_size;
+		u8 instruction_size;
+		// whether the values and objects sections exist
+		u8 has_heap;
+
+		u32 instruction_count;
+		u32 constant_count;
+		u32 string_count;
+		u32 function_count;
+		u32 prototype_count;
+		u32 global_count;
+		// number of distinct variables that aren't globals (function locals,
+		// static class variables, variables declared in blocks)
+		u32 local_count;
+		u32 cache_count;
+		u32 source_count;
+		u32 object_count;
+		u32 unused;
+
+		// offset of each section from the start of the file
+		u64 instructions;
+		u64 source_map;
+		u64 constants;
+		u64 strings;
+		u64 functions;
+		u64 prototypes;
+		u64 globals;
+		u64 caches;
+		u64 sources;
+		u64 values;
+		u64 objects;
+	};
+
+	// a token, its text and file are indices into the string section
+	struct module_token {
+		u32 text;
+		u32 file;
+		u32 line;
+		u32 col;
+	};
+
+	enum module_constant_kind {
+		mc_null = 0,
+		// number, stored in value
+		mc_value,
+		// string constant, index is a string
+		mc_string,
+		// index is a function in the module
+		mc_function,
+		// c++ function that the loading context must have bound, index is its name
+		mc_bound_function,
+		// index is a prototype in the module
+		mc_prototype,
+		// index is a global in the module, bound by name to the loading
+		// context's global if it has one with the same name
+		mc_global,
+		// index is a local, locals are numbered from 1
+		mc_local,
+		// index is an object in the heap section, only used for values
+		mc_object
+	};
+
+	// an entry of the constant pool that instruction operands index, or the
+	// value of a variable in the heap section
+	struct module_constant {
+		u8 kind;
+		u8 unused;
+		type_id type;
+		// meaning depends on kind, the size of the value for mc_value
+		u32 index;
+		u64 value;
+	};
+
+	// followed by param_count module_params, then declared_var_count
+	// local indices (u32)
+	struct module_function {
+		module_token name;
+		u32 entry_point;
+		u32 instruction_count;
+		u8 is_global;
+		u8 param_count;
+		u16 unused;
+		u32 declared_var_count;
+	};
+
+	struct module_param {
+		module_token name;
+		// local index, 0 if the parameter is only a register
+		u32 local;
+		u32 is_const;
+	};
+
+	// followed by method_count and static_method_count function indices (u32),
+	// then static_var_count pairs of a name (string index) and a local index
+	struct module_prototype {
+		module_token declaration;
+		// function index, or module_none
+		u32 constructor;
+		u32 method_count;
+		u32 static_method_count;
+		u32 static_var_count;
+	};
+
+	struct module_global {
+		module_token name;
+		u32 is_const;
+	};
+
+	// followed by property_count pairs of a name (string index) and the
+	// property's value (module_constant)
+	struct module_object {
+		// prototype index, or module_none
+		u32 prototype;
+		u32 property_count;
+	};
+
+	// strings are stored as a u32 length followed by that many bytes. caches
+	// are the string index of their property name, sources are the string
+	// indices of the file name and the code. values are a module_constant for
+	// each global followed by one for each local, mc_null if it had no value
+	static const u32 module_none = 0xFFFFFFFF;
+
+	struct loaded_function {
+		module_function info;
+		std::vector<module_param> params;
+		std::vector<u32> declared_vars;
+	};
+
+	struct loaded_prototype {
+		module_prototype info;
+		std::vector<u32> methods;
+		std::vector<u32> static_methods;
+		std::vector<std::pair<u32, u32>> static_vars;
+	};
+
+	struct loaded_object {
+		module_object info;
+		std::vector<std::pair<u32, module_constant>> properties;
+	};
+
+	struct loaded_source {
+		// string index
+		u32 file;
+		// shared with the instruction arrays that the module is loaded into
+		std::shared_ptr<const std::string> code;
+	};
+
+	// a module that has been read and checked, with each section in its own
+	// array. nothing in it depends on the context that will load it, and
+	// loading it doesn't change it, so any number of contexts can load the
+	// same image at once. strings and indices mean the same as in the file
+	struct module_image {
+		std::string name;
+		module_header header;
+		std::vector<instruction_array::encoded_instruction> instructions;
+		std::vector<instruction_array::source_location> source_map;
+		std::vector<std::string> strings;
+		std::vector<module_constant> constants;
+		std::vector<loaded_function> functions;
+		std::vector<loaded_prototype> prototypes;
+		std::vector<module_global> globals;
+		std::vector<u32> caches;
+		std::vector<loaded_source> sources;
+		// only read from snapshots
+		std::vector<module_constant> values;
+		std::vector<loaded_object> objects;
+	};
+
+	// writes everything that was compiled in 'ctx' to 'path'. if 'heap' is true
+	// the values of the variables and the objects they refer to are written too
+	bool write_module(context* ctx, const std::string& path, bool heap);
+	// writes the module to 'out' instead of a file, 'module_name' is used in errors
+	bool write_module(context* ctx, std::vector<u8>& out, const std::string& module_name, bool heap);
+
+	// appends the instructions of the module at 'path' to those of 'ctx' and
+	// defines its functions, prototypes and globals. the module's top level
+	// code starts at what was the end of the instruction array. if 'heap' is
+	// true the module must be a snapshot, and its variables are given the
+	// values that they had when it was written
+	bool read_module(context* ctx, const std::string& path, bool heap);
+	// loads a module that is already in memory. 'data' is only read, so any
+	// number of contexts can load the same module at once
+	bool read_module(context* ctx, const std::vector<u8>& data, const std::string& module_name, bool heap);
+	// reads the file at 'path' into 'data' without loading it
+	bool read_module_file(const std::string& path, std::vector<u8>& data);
+	// reads and checks the module in 'data' without loading it, 'module_name'
+	// is used in errors
+	bool read_module_image(const std::vector<u8>& data, const std::string& module_name, module_image& image);
+	// loads an image the way read_module loads a module. if 'shared' is true
+	// the image outlives 'ctx', and when 'ctx' hasn't compiled anything yet its
+	// instruction array uses the image's instructions and source map where
+	// they are instead of copying them. 'ctx' still gets its own constants,
+	// caches, functions, prototypes and variables
+	bool load_module_image(context* ctx, const module_image& image, bool heap, bool shared);
+};
\ No newline at end of file
@@ -3,6 +3,19 @@
 using namespace std;
 
 namespace rs {
+	// characters that keywords and operators are made of
+	static inline bool is_keyword_char(char c) {
+		return
+			(c >= 48 && c <= 57 ) || // 0 - 9
+			(c >= 65 && c <= 90 ) || // A - Z
+			(c >= 97 && c <= 122) || // a - z
+			c == '_' || c == '+' || c == '-' ||
+			c == '*' || c == '/' || c == '&' ||
+			c == '%' || c == '^' || c == '|' ||
+			c == '=' || c == '!' || c == '<' ||
+			c == '>';
+	}
+
 	vector<string> split(const string& str, const string& delimiters) {
 		vector<string> out;
 
@@ -40,6 +53,30 @@ namespace rs {
 		return out;
 	}
 
+	void find_lines(const string& text, vector<u32>& offsets) {
+		bool lastWasNewline = false;
+		u32 start = 0;
+		for (u32 i = 0;i < text.length();i++) {
+			char c = text[i];
+			if (c == '\n' || c == '\r') {
+				if (!lastWasNewline) {
+					offsets.push_back(start);
+					offsets.push_back(i);
+					lastWasNewline = true;
+				}
+				continue;
+			}
+
+			if (lastWasNewline) start = i;
+			lastWasNewline = false;
+		}
+
+		if (text.length() > 0 && !lastWasNewline) {
+			offsets.push_back(start);
+			offsets.push_back(u32(text.length()));
+		}
+	}
+
 	parse_exception::parse_exception(const string& _text, const string& _file, const string& _lineText, u32 _line, u32 _col) {
 		text = _text;
 		file = _file;
@@ -50,29 +87,86 @@ namespace rs {
 
 	parse_exception::~parse_exception() { }
 
-	tokenizer::tokenizer(const string& file, const string& input) {
-		m_input = input;
+	keyword_set::keyword_set(initializer_list<const char*> keywords) {
+		m_nodes.push_back({ 0, false, 0, 0 });
+		for (u8 c = 0;c < 128;c++) m_first[c] = 0;
+		for (const char* kw : keywords) add(kw);
+	}
+
+	keyword_set::~keyword_set() {
+	}
+
+	void keyword_set::add(const string& keyword) {
+		u16 n = 0;
+		for (size_t i = 0;i < keyword.length();i++) {
+			char c = keyword[i];
+			u16 next = n == 0 ? m_first[c & 127] : m_nodes[n].child;
+			while (next && m_nodes[next].c != c) next = m_nodes[next].sibling;
+
+			if (!next) {
+				next = u16(m_nodes.size());
+				if (n == 0) {
+					m_nodes.push_back({ c, false, 0, m_first[c & 127] });
+					m_first[c & 127] = next;
+				} else {
+					m_nodes.push_back({ c, false, 0, m_nodes[n].child });
+					m_nodes[n].child = next;
+				}
+			}
+
+			n = next;
+		}
+
+		if (n != 0) m_nodes[n].terminal = true;
+	}
+
+	bool keyword_set::contains(const char* str, size_t length) const {
+		if (length == 0) return false;
+
+		u16 n = m_first[str[0] & 127];
+		while (n && m_nodes[n].c != str[0]) n = m_nodes[n].sibling;
+		if (!n) return false;
+
+		for (size_t i = 1;i < length;i++) {
+			n = m_nodes[n].child;
+			while (n && m_nodes[n].c != str[i]) n = m_nodes[n].sibling;
+			if (!n) return false;
+		}
+
+		return m_nodes[n].terminal;
+	}
+
+
+
+	tokenizer::tokenizer(const string& file, const string& input, const keyword_set& keywords) : m_keywords(keywords), m_input(input) {
 		m_file = file;
 		m_line = 0;
 		m_col = 0;
 		m_idx = 0;
-
-		lines = split(input, "\n\r");
 	}
 
 	tokenizer::~tokenizer() {
 	}
 
-	void tokenizer::specify_keyword(const string& keyword) {
-		m_keywords.push_back(keyword);
+	bool tokenizer::is_keyword(const string& thing) const {
+		return m_keywords.contains(thing.c_str(), thing.length());
 	}
-	
-	bool tokenizer::is_keyword(const string& thing) {
-		for (const string& kw : m_keywords) {
-			if (kw == thing) return true;
+
+	const string& tokenizer::line_text(u32 line) {
+		static const string none;
+
+		if (m_lineOffsets.empty()) {
+			find_lines(m_input, m_lineOffsets);
+			m_lines.resize(m_lineOffsets.size() / 2);
 		}
 
-		return false;
+		if (line >= m_lines.size()) return none;
+
+		string& text = m_lines[line];
+		u32 start = m_lineOffsets[line * 2];
+		u32 end = m_lineOffsets[line * 2 + 1];
+		if (text.length() != end - start) text.assign(m_input, start, end - start);
+		return text;
 	}
 
 	void tokenizer::backup_state() {
@@ -107,7 +201,11 @@ namespace rs {
 			if (c == '\n' || c == '\r') {
 				if (!lastWasNewline) {
 					lastWasNewline = true;
-					if (m_line < lines.size() - 1) {
+
+					// line breaks at the end of the input don't start a new line
+					u32 next = m_idx + 1;
+					while (next < m_input.length() && (m_input[next] == '\n' || m_input[next] == '\r')) next++;
+					if (next < m_input.length()) {
 						m_line++;
 						m_col = 0;
 					}
@@ -122,6 +220,37 @@ namespace rs {
 		return hadWhitespace;
 	}
 
+	char tokenizer::peek() {
+		whitespace();
+		if (m_idx == m_input.length()) return 0;
+		return m_input[m_idx];
+	}
+
+	u32 tokenizer::keyword_length() {
+		whitespace();
+
+		u32 offset = 0;
+		while (m_idx + offset < m_input.length()) {
+			char c = m_input[m_idx + offset];
+			if (c >= 48 && c <= 57 && offset == 0) return 0;
+			if (!is_keyword_char(c)) break;
+			offset++;
+		}
+
+		return offset;
+	}
+
+	tokenizer::token tokenizer::consume(u32 length) {
+		token out;
+		out.line = m_line;
+		out.col = m_col;
+		out.text.assign(m_input, m_idx, length);
+		out.file = m_file;
+		m_idx += length;
+		m_col += length;
+		return out;
+	}
+
 	string tokenizer::thing() {
 		string out;
 		while(!at_end()) {
@@ -142,54 +271,47 @@ namespace rs {
 		whitespace();
 		out.line = m_line;
 		out.col = m_col;
-		out.file = m_file;
 
 		size_t offset = 0;
 
-		while(!at_end()) {
+		while (m_idx + offset < m_input.length()) {
 			char c = m_input[m_idx + offset];
-			if (c >= 48 && c <= 57 && out.text.length() == 0) {
+			if (c >= 48 && c <= 57 && offset == 0) {
 				if (!expected) return out;
 				// 0 - 9
 				throw parse_exception(
 					"Expected keyword, found numerical constant",
 					m_file,
-					lines[m_line],
+					line_text(m_line),
 					m_line,
 					m_col
 				);
 			}
 
-			if (c == '\'' || c == '"' && out.text.length() == 0) {
-				if (!expected) return out;
+			if (c == '\'' || c == '"' && offset == 0) {
+				if (!expected) {
+					out.text.assign(m_input, m_idx, offset);
+					out.file = m_file;
+					return out;
+				}
 				throw parse_exception(
 					"Expected keyword, found string constant",
 					m_file,
-					lines[m_line],
+					line_text(m_line),
 					m_line,
 					m_col
 				);
 			}
 
-			if (
-				(c >= 48 && c <= 57 ) || // 0 - 9
-				(c >= 65 && c <= 90 ) || // A - Z
-				(c >= 97 && c <= 122) || // a - z
-				c == '_' || c == '+' || c == '-' ||
-				c == '*' || c == '/' || c == '&' ||
-				c == '%' || c == '^' || c == '|' ||
-				c == '=' || c == '!' || c == '<' ||
-				c == '>'
-			) {
-				out.text += c;
+			if (is_keyword_char(c)) {
 				offset++;
 			} else {
-				if (out.text.length() == 0) {
+				if (offset == 0) {
 					if (!expected) return out;
 					throw parse_exception(
 						"Expected keyword, found something else",
 						m_file,
-						lines[m_line],
+						line_text(m_line),
 						m_line,
 						m_col
 					);
@@ -197,28 +319,30 @@ namespace rs {
 			}
 		}
 
-		if (!is_keyword(out.text)) {
-			if (!expected) return { 0, 0, "", "" };
+		if (!m_keywords.contains(m_input.c_str() + m_idx, offset)) {
+			if (!expected) return token();
 			throw parse_exception(
 				"Expected keyword, found identifier",
 				m_file,
-				lines[m_line],
+				line_text(m_line),
 				m_line,
 				m_col
 			);
 		}
 
-		if (out.text != kw && kw.length() > 0) {
-			if (!expected) return { 0, 0, "", "" };
+		if (kw.length() > 0 && m_input.compare(m_idx, offset, kw) != 0) {
+			if (!expected) return token();
 			throw parse_exception(
-				format("Expected keyword '%s', found '%s'", kw.c_str(), out.text.c_str()),
+				format("Expected keyword '%s', found '%s'", kw.c_str(), m_input.substr(m_idx, offset).c_str()),
 				m_file,
-				lines[m_line],
+				line_text(m_line),
 				m_line,
 				m_col
 			);
 		}
 
+		out.text.assign(m_input, m_idx, offset);
+		out.file = m_file;
 		m_idx += offset;
 		m_col += offset;
 
@@ -231,30 +355,33 @@ namespace rs {
 		whitespace();
 		out.line = m_line;
 		out.col = m_col;
-		out.file = m_file;
 
 		size_t offset = 0;
 
-		while(!at_end()) {
+		while (m_idx + offset < m_input.length()) {
 			char c = m_input[m_idx + offset];
-			if (c >= 48 && c <= 57 && out.text.length() == 0) {
+			if (c >= 48 && c <= 57 && offset == 0) {
 				if (!expected) return out;
 				// 0 - 9
 				throw parse_exception(
 					"Expected identifier, found numerical constant",
 					m_file,
-					lines[m_line],
+					line_text(m_line),
 					m_line,
 					m_col
 				);
 			}
 
-			if (c == '\'' || c == '"' && out.text.length() == 0) {
-				if (!expected) return out;
+			if (c == '\'' || c == '"' && offset == 0) {
+				if (!expected) {
+					out.text.assign(m_input, m_idx, offset);
+					out.file = m_file;
+					return out;
+				}
 				throw parse_exception(
 					"Expected identifier, found string constant",
 					m_file,
-					lines[m_line],
+					line_text(m_line),
 					m_line,
 					m_col
 				);
@@ -266,15 +393,14 @@ namespace rs {
 				(c >= 97 && c <= 122) || // a - z
 				c == '_'
 			) {
-				out.text += c;
 				offset++;
 			} else {
-				if (out.text.length() == 0) {
+				if (offset == 0) {
 					if (!expected) return out;
 					throw parse_exception(
 						"Expected identifier, found something else",
 						m_file,
-						lines[m_line],
+						line_text(m_line),
 						m_line,
 						m_col
 					);
@@ -282,28 +408,30 @@ namespace rs {
 			}
 		}
 		
-		if (is_keyword(out.text)) {
-			if (!expected) return { 0, 0, "", "" };
+		if (m_keywords.contains(m_input.c_str() + m_idx, offset)) {
+			if (!expected) return token();
 			throw parse_exception(
 				"Expected identifier, found keyword",
 				m_file,
-				lines[m_line],
+				line_text(m_line),
 				m_line,
 				m_col
 			);
 		}
 
-		if (out.text != identifier && identifier.length() > 0) {
-			if (!expected) return { 0, 0, "", "" };
+		if (identifier.length() > 0 && m_input.compare(m_idx, offset, identifier) != 0) {
+			if (!expected) return token();
 			throw parse_exception(
-				format("Expected identifier '%s', found '%s'", identifier.c_str(), out.text.c_str()),
+				format("Expected identifier '%s', found '%s'", identifier.c_str(), m_input.substr(m_idx, offset).c_str()),
 				m_file,
-				lines[m_line],
+				line_text(m_line),
 				m_line,
 				m_col
 			);
 		}
 
+		out.text.assign(m_input, m_idx, offset);
+		out.file = m_file;
 		m_idx += offset;
 		m_col += offset;
 
@@ -316,10 +444,10 @@ namespace rs {
 		whitespace();
 		out.line = m_line;
 		out.col = m_col;
-		out.file = m_file;
 
 		if (m_input[m_idx] == c) {
 			out.text = c;
+			out.file = m_file;
 			m_idx++;
 			m_col++;
 		} else {
@@ -328,7 +456,7 @@ namespace rs {
 			throw parse_exception(
 				format("Expected '%c', found \"%s\"", c, found.c_str()),
 				m_file,
-				lines[m_line],
+				line_text(m_line),
 				m_line,
 				m_col
 			);
@@ -343,10 +471,9 @@ namespace rs {
 		whitespace();
 		out.line = m_line;
 		out.col = m_col;
-		out.file = m_file;
 
 		token bt = character('\'', expected);
-		if (bt.text.length() == 0) return { 0, 0, "", "" };
+		if (bt.text.length() == 0) return token();
 
 		if (!strip_quotes) out.text += '\'';
 		bool foundEnd = false;
@@ -381,7 +508,7 @@ namespace rs {
 			throw parse_exception(
 				"Encountered unexpected end of file while parsing string constant",
 				m_file,
-				lines[bt.line],
+				line_text(bt.line),
 				bt.line,
 				bt.col
 			);
@@ -391,12 +518,13 @@ namespace rs {
 			throw parse_exception(
 				"String should not be empty",
 				m_file,
-				lines[bt.line],
+				line_text(bt.line),
 				bt.line,
 				bt.col
 			);
 		}
 
+		out.file = m_file;
 		return out;
 	}
 
@@ -406,43 +534,39 @@ namespace rs {
 		whitespace();
 		out.line = m_line;
 		out.col = m_col;
-		out.file = m_file;
 
 		bool isNeg = false;
 		bool hasDecimal = false;
 		size_t offset = 0;
 
-		while (!at_end()) {
+		while (m_idx + offset < m_input.length()) {
 			char c = m_input[m_idx + offset];
 			if (c == '-') {
-				if (out.text.length() != 0) break;
+				if (offset != 0) break;
 				isNeg = true;
-				out.text += c;
 				offset++;
 			} else if (c == '.') {
 				if (hasDecimal) {
-					if (!expected) return { 0, 0, "", "" };
+					if (!expected) return token();
 					throw parse_exception(
 						"Numerical constants can only contain one decimal point",
 						m_file,
-						lines[m_line],
+						line_text(m_line),
 						m_line,
 						m_col
 					);
 				}
 				hasDecimal = true;
-				out.text += c;
 				offset++;
 			} else if (c >= 48 && c <= 57) {
-				out.text += c;
 				offset++;
 			} else {
-				if (out.text.length() == 0) {
-					if (!expected) return { 0, 0, "", "" };
+				if (offset == 0) {
+					if (!expected) return token();
 					throw parse_exception(
 						format("Expected numerical constant, found '%s'", thing().c_str()),
 						m_file,
-						lines[m_line],
+						line_text(m_line),
 						m_line,
 						m_col
 					);
@@ -451,6 +575,8 @@ namespace rs {
 			}
 		}
 
+		out.text.assign(m_input, m_idx, offset);
+		out.file = m_file;
 		m_idx += offset;
 		m_col += offset;
 
@@ -3,10 +3,15 @@
 #include <string>
 #include <stack>
 #include <vector>
+#include <initializer_list>
 
 namespace rs {
 	std::vector<std::string> split(const std::string& str, const std::string& delimiters);
 	std::string format(const char* fmt, ...);
+	// appends where each line of 'text' starts and ends to 'offsets'. lines are split the
+	// same way as split(text, "\n\r"), a run of line breaks ends a line and blank lines
+	// aren't counted
+	void find_lines(const std::string& text, std::vector<u32>& offsets);
 
 	class parse_exception : public std::exception {
 		public:
@@ -21,24 +26,54 @@ namespace rs {
 			u32 col;
 	};
 
+	// a trie of the keywords that a tokenizer recognizes. it's built once and
+	// can be shared by any number of tokenizers
+	class keyword_set {
+		public:
+			keyword_set(std::initializer_list<const char*> keywords);
+			~keyword_set();
+
+			void add(const std::string& keyword);
+			// whether the 'length' characters at 'str' are a keyword
+			bool contains(const char* str, size_t length) const;
+
+		protected:
+			struct node {
+				char c;
+				bool terminal;
+				// indices of the first node that follows this one and of the next
+				// node with the same parent, 0 if there is none
+				u16 child;
+				u16 sibling;
+			};
+
+			// the root is m_nodes[0]. its children are indexed by character
+			std::vector<node> m_nodes;
+			u16 m_first[128];
+	};
+
 	class tokenizer {
 		public:
-			tokenizer(const std::string& file, const std::string& input);
+			// 'input' and 'keywords' are not copied, they must outlive the tokenizer
+			tokenizer(const std::string& file, const std::string& input, const keyword_set& keywords);
 			~tokenizer();
 
 			struct token {
 				u32 line = 0;
 				u32 col = 0;
-				std::string text = "";
-				std::string file = "";
+				std::string text;
+				std::string file;
 
 				inline const bool valid() const { return text.length() != 0; }
 				inline const bool operator == (const token& rhs) const { return text == rhs.text; }
 				inline const bool operator == (const std::string& rhs) const { return text == rhs; }
 			};
 
-			void specify_keyword(const std::string& keyword);
-			bool is_keyword(const std::string& thing);
+			bool is_keyword(const std::string& thing) const;
+			inline const std::string& file() const { return m_file; }
+			// the text of a line, for diagnostics. lines are found the first time
+			// this is called
+			const std::string& line_text(u32 line);
 			inline u32 line() const { return m_line; }
 			inline u32 col() const { return m_col; }
 			inline const bool at_end(bool check_whitespace = true) {
@@ -51,6 +86,18 @@ namespace rs {
 			void restore_state();
 
 			bool whitespace();
+			// skips whitespace and returns the next character without consuming
+			// it, 0 at the end of the input
+			char peek();
+			// skips whitespace and returns the length of the keyword characters
+			// that start at the current position without consuming them. 0 if
+			// they start with a digit or a quote. this doesn't check that they
+			// form a keyword
+			u32 keyword_length();
+			// the input at the current position
+			inline const char* current() const { return m_input.c_str() + m_idx; }
+			// consumes 'length' characters, which must not span lines
+			token consume(u32 length);
 			std::string thing();
 			token semicolon(bool expected = true);
 			token keyword(bool expected = true, const std::string& kw = "");
@@ -59,12 +106,14 @@ namespace rs {
 			token string_constant(bool expected = true, bool strip_quotes = false, bool allow_empty = true);
 			token number_constant(bool expected = true);
 
-			std::vector<std::string> lines;
-
 		protected:
-			std::vector<std::string> m_keywords;
+			const keyword_set& m_keywords;
 			std::string m_file;
-			std::string m_input;
+			const std::string& m_input;
+			// where each line starts and ends in m_input. the text of a line is
+			// copied when it's first requested
+			std::vector<u32> m_lineOffsets;
+			std::vector<std::string> m_lines;
 			struct stored_state {
 				u32 idx;
 				u32 line;
@@ -0,0 +1,512 @@
+#include <parser.h>
+using namespace std;
+
+namespace rs {
+	using token = tokenizer::token;
+
+	static const struct {
+		const char* text;
+		rs_instruction op;
+	} operators[] = {
+		{ "==" , rs_instruction::compare   },
+		{ "+=" , rs_instruction::addEq     },
+		{ "-=" , rs_instruction::subEq     },
+		{ "*=" , rs_instruction::mulEq     },
+		{ "/=" , rs_instruction::divEq     },
+		{ "%=" , rs_instruction::modEq     },
+		{ "^=" , rs_instruction::powEq     },
+		{ "||=", rs_instruction::orEq      },
+		{ "&&=", rs_instruction::andEq     },
+		{ "<=" , rs_instruction::lessEq    },
+		{ ">=" , rs_instruction::greaterEq },
+		{ "++" , rs_instruction::inc       },
+		{ "--" , rs_instruction::dec       },
+		{ "="  , rs_instruction::store     },
+		{ "+"  , rs_instruction::add       },
+		{ "-"  , rs_instruction::sub       },
+		{ "*"  , rs_instruction::mul       },
+		{ "/"  , rs_instruction::div       },
+		{ "%"  , rs_instruction::mod       },
+		{ "^"  , rs_instruction::pow       },
+		{ "||" , rs_instruction::or        },
+		{ "&&" , rs_instruction::and       },
+		{ "<"  , rs_instruction::less      },
+		{ ">"  , rs_instruction::greater   }
+	};
+
+	// index of the operator that is exactly the first 'length' characters of
+	// 'text', -1 if there isn't one. operators are only compared against those
+	// that start with the same character
+	static i32 find_operator(const char* text, u32 length) {
+		static const u8 none = 0xFF;
+		static const struct operator_table {
+			// indices into operators[] by first character, ended by 'none'.
+			// operators that aren't keywords are left out, the tokenizer
+			// would never have returned them
+			u8 first[128][4];
+
+			operator_table() {
+				memset(first, none, sizeof(first));
+				for (u8 i = 0;i < sizeof(operators) / sizeof(operators[0]);i++) {
+					const char* op = operators[i].text;
+					if (!script_parser::keywords().contains(op, strlen(op))) continue;
+
+					u8* slot = first[op[0] & 127];
+					while (*slot != none) slot++;
+					*slot = i;
+				}
+			}
+		} table;
+
+		if (length == 0) return -1;
+
+		const u8* candidates = table.first[text[0] & 127];
+		for (u8 i = 0;i < 4 && candidates[i] != none;i++) {
+			const char* op = operators[candidates[i]].text;
+			if (strncmp(op, text, length) == 0 && op[length] == 0) return candidates[i];
+		}
+
+		return -1;
+	}
+
+	script_parser::script_parser(tokenizer& t, syntax_tree& tree) : m_tokens(t), m_tree(tree) {
+	}
+
+	script_parser::~script_parser() {
+	}
+
+	void script_parser::parse() {
+		while (!m_tokens.at_end()) {
+			ast_node* statement = parse_statement();
+			if (statement) m_tree.root->children.push_back(statement);
+		}
+	}
+
+	const keyword_set& script_parser::keywords() {
+		static const keyword_set set({
+			"function", "return", "const", "let", "if", "else", "while", "for", "class", "extends", "export", "continue", "break", "new", "static",
+			"constructor", "?", ":", "+", "-", "*", "/", "%", "^", "=", "!", "<", ">",
+			"++", "--", "+=", "-=", "*=", "/=", "%=", "^=", "==", "!=", "<=", ">=", "&&",
+			"||", "=>"
+		});
+
+		return set;
+	}
+
+	token script_parser::position() {
+		token out;
+		out.line = m_tokens.line();
+		out.col = m_tokens.col();
+		out.file = m_tokens.file();
+		return out;
+	}
+
+	void script_parser::error(const string& text, const token& at) {
+		throw parse_exception(
+			text,
+			m_tokens.file(),
+			m_tokens.line_text(at.line),
+			at.line,
+			at.col
+		);
+	}
+
+	ast_node* script_parser::parse_statement(bool parseSemicolon) {
+		// Statements can start with:
+		//	- return, if, while, for, const, let
+		//	- expressions (but the result will be ignored by the rest of the code)
+		tokenizer& t = m_tokens;
+
+		t.backup_state();
+		token kw = t.keyword(false);
+		if (!kw.valid() || kw.text == "new") {
+			t.restore_state();
+			ast_node* expr = parse_expression(true);
+			if (parseSemicolon) t.character(';');
+			return expr;
+		}
+		t.commit_state();
+
+		if (kw.text == "return") {
+			ast_node* node = m_tree.node(ast_node_type::nt_return, kw);
+			ast_node* expr = parse_expression(false);
+			if (expr) node->children.push_back(expr);
+			if (parseSemicolon) t.character(';');
+			return node;
+		}
+		else if (kw.text == "if") {
+			ast_node* node = m_tree.node(ast_node_type::nt_if, kw);
+			t.character('(');
+			node->children.push_back(parse_expression(true));
+			t.character(')');
+
+			node->children.push_back(parse_body(parseSemicolon, "'if' statement body"));
+
+			token else_kw = t.keyword(false, "else");
+			if (else_kw.valid()) node->children.push_back(parse_body(parseSemicolon, "'else' statement body"));
+			return node;
+		}
+		else if (kw.text == "while") {
+			ast_node* node = m_tree.node(ast_node_type::nt_while, kw);
+			t.character('(');
+			node->children.push_back(parse_expression(true));
+			t.character(')');
+
+			token block_open = t.character('{', false);
+			if (block_open.valid()) node->children.push_back(parse_block(block_open, "'for' loop body"));
+			else {
+				ast_node* body = m_tree.node(ast_node_type::nt_body);
+				ast_node* statement = parse_statement(parseSemicolon);
+				if (statement) body->children.push_back(statement);
+				node->children.push_back(body);
+			}
+			return node;
+		}
+		else if (kw.text == "for") {
+			ast_node* node = m_tree.node(ast_node_type::nt_for, kw);
+			node->open = t.character('(');
+
+			ast_node* initializer = nullptr;
+			if (!t.semicolon(false).valid()) initializer = parse_statement();
+
+			ast_node* condition = nullptr;
+			if (!t.semicolon(false).valid()) {
+				condition = parse_expression(true);
+				t.semicolon();
+			}
+
+			ast_node* increment = nullptr;
+			if (!t.character(')', false).valid()) {
+				increment = parse_statement(false);
+				t.character(')');
+			}
+
+			node->children.push_back(initializer);
+			node->children.push_back(condition);
+			node->children.push_back(increment);
+			node->children.push_back(parse_body(parseSemicolon, "'for' loop body"));
+			return node;
+		}
+		else if (kw.text == "const" || kw.text == "let") {
+			t.backup_state();
+			token var_name = t.identifier();
+			bool uninitialized = t.semicolon(false).valid();
+			// the initializer expression starts with the variable name
+			t.restore_state();
+
+			ast_node* node = m_tree.node(kw.text == "const" ? ast_node_type::nt_const : ast_node_type::nt_let, var_name);
+			if (!uninitialized) node->children.push_back(parse_expression(true));
+			else if (kw.text == "let") t.identifier();
+
+			if (parseSemicolon) t.character(';');
+			return node;
+		}
+		else if (kw.text == "else") error("Encountered 'else' without an 'if'", kw);
+		else if (kw.text == "class") return parse_class(kw);
+		else if (kw.text == "function") return parse_function();
+
+		return nullptr;
+	}
+
+	ast_node* script_parser::parse_block(const token& open, const char* error_text) {
+		tokenizer& t = m_tokens;
+		ast_node* block = m_tree.node(ast_node_type::nt_block);
+		block->open = open;
+
+		token closed;
+		while (!t.at_end()) {
+			closed = t.character('}', false);
+			if (closed.valid()) break;
+
+			ast_node* statement = parse_statement();
+			if (statement) block->children.push_back(statement);
+		}
+
+		if (!closed.valid()) error(format("Encountered unexpected end of input while parsing %s", error_text), open);
+		block->close = closed;
+		return block;
+	}
+
+	ast_node* script_parser::parse_body(bool parseSemicolon, const char* error_text) {
+		tokenizer& t = m_tokens;
+		token block_open = t.character('{', false);
+		if (block_open.valid()) return parse_block(block_open, error_text);
+
+		ast_node* body = m_tree.node(ast_node_type::nt_body);
+		ast_node* statement = parse_statement(false);
+		if (statement) body->children.push_back(statement);
+
+		if (parseSemicolon) body->close = t.semicolon();
+		else body->close = position();
+		return body;
+	}
+
+	ast_node* script_parser::parse_function(bool allow_name) {
+		tokenizer& t = m_tokens;
+		ast_node* node = m_tree.node(ast_node_type::nt_function);
+		node->open = position();
+
+		node->tok = t.identifier(false);
+		if (node->tok.valid() && !allow_name) error("Named function can not be declared here", node->tok);
+		// anonymous functions are still declared somewhere
+		if (!node->tok.valid()) node->tok = position();
+
+		t.character('(');
+		for(unsigned char i = 0;i < 8;i++) {
+			token pname = t.identifier(false);
+			if (!pname.valid()) break;
+			node->children.push_back(m_tree.node(ast_node_type::nt_identifier, pname));
+
+			token comma = t.character(',', false);
+			if (!comma.valid()) break;
+		}
+		t.character(')');
+
+		token body_open = t.character('{');
+		ast_node* body = parse_block(body_open, "function body");
+		node->children.push_back(body);
+		node->close = body->close;
+		return node;
+	}
+
+	ast_node* script_parser::parse_class(const token& kw) {
+		tokenizer& t = m_tokens;
+		ast_node* node = m_tree.node(ast_node_type::nt_class, t.identifier());
+		node->open = kw;
+		token inheritance_token = t.character(':', false);
+		if (inheritance_token.valid()) t.identifier();
+
+		token open = t.character('{');
+		token close = t.character('}', false);
+		while (!t.at_end() && !close.valid()) {
+			token static_kw = t.keyword(false, "static");
+			token ctor_kw = t.keyword(false, "constructor");
+			if (static_kw.valid()) {
+				ast_node* member = m_tree.node(ast_node_type::nt_static, t.identifier());
+				token initialized = t.keyword(false, "=");
+				if (initialized.valid()) {
+					member->open = initialized;
+					member->children.push_back(parse_expression(true));
+					t.character(';');
+				} else if (!t.semicolon(false).valid()) {
+					// must be a static function
+					member->children.push_back(parse_function());
+				}
+				node->children.push_back(member);
+			} else if (ctor_kw.valid()) {
+				ast_node* member = m_tree.node(ast_node_type::nt_constructor, ctor_kw);
+				member->children.push_back(parse_function());
+				node->children.push_back(member);
+			} else node->children.push_back(parse_function());
+
+			close = t.character('}', false);
+		}
+
+		if (!close.valid()) error("Encountered unexpected end of input while parsing class body", open);
+		t.semicolon();
+		return node;
+	}
+
+	ast_node* script_parser::parse_expression(bool expected) {
+		ast_node* value = parse_value(expected);
+		if (!value) return nullptr;
+
+		ast_node* expr = m_tree.node(ast_node_type::nt_expression);
+		expr->children.push_back(value);
+
+		ast_node* op = parse_operator();
+		if (!op) expr->close = position();
+
+		for (;op;op = parse_operator()) expr->children.push_back(op);
+		return expr;
+	}
+
+	ast_node* script_parser::parse_operator() {
+		tokenizer& t = m_tokens;
+		u32 length = t.keyword_length();
+		i32 idx = find_operator(t.current(), length);
+		if (idx < 0) return nullptr;
+
+		ast_node* op = m_tree.node(ast_node_type::nt_operator, t.consume(length));
+		op->op = operators[idx].op;
+		if (op->op != rs_instruction::inc && op->op != rs_instruction::dec) op->children.push_back(parse_value(true));
+		op->close = position();
+		return op;
+	}
+
+	ast_node* script_parser::parse_value(bool expected) {
+		tokenizer& t = m_tokens;
+
+		// each kind of value can only start with certain characters, so only
+		// the ones that could match are tried
+		char c = t.peek();
+		bool word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+		u32 length = word ? t.keyword_length() : 0;
+		auto word_is = [&t, length](const char* kw) {
+			return strncmp(t.current(), kw, length) == 0 && kw[length] == 0;
+		};
+
+		token subexpr_open = c == '(' ? t.character('(', false) : token();
+		if (subexpr_open.valid()) {
+			ast_node* node = m_tree.node(ast_node_type::nt_parenthesis);
+			node->open = subexpr_open;
+			node->children.push_back(parse_expression(true));
+			node->close = t.character(')');
+			return parse_accessor_chain(node);
+		}
+
+		token new_kw = word && word_is("new") ? t.consume(length) : token();
+		if (new_kw.valid()) {
+			ast_node* node = m_tree.node(ast_node_type::nt_new, new_kw);
+			node->children.push_back(parse_value(true));
+			return parse_accessor_chain(node);
+		}
+
+		token func_kw = word && word_is("function") ? t.consume(length) : token();
+		if (func_kw.valid()) return parse_accessor_chain(parse_function(false));
+
+		token identifier = word ? t.identifier(false) : token();
+		if (identifier.valid()) return parse_accessor_chain(m_tree.node(ast_node_type::nt_identifier, identifier));
+
+		bool number = (c >= '0' && c <= '9') || c == '-' || c == '.';
+		token const_token = number ? t.number_constant(false) : token();
+		if (const_token.valid()) {
+			bool too_large = false;
+			if (const_token.text.find_first_of(".") != string::npos) {
+				double num = atof(const_token.text.c_str());
+				too_large = num < rs_decimal_min || num > rs_decimal_max;
+			} else {
+				auto num = atoll(const_token.text.c_str());
+				too_large = num < rs_integer_min || num > rs_integer_max;
+			}
+
+			if (too_large) error(format("Number '%s' is too large for internal data type", const_token.text.c_str()), const_token);
+			return parse_accessor_chain(m_tree.node(ast_node_type::nt_number, const_token));
+		}
+
+		const_token = c == '\'' ? t.string_constant(false, true) : token();
+		if (const_token.valid()) return parse_accessor_chain(m_tree.node(ast_node_type::nt_string, const_token));
+
+		ast_node* obj = c == '{' ? parse_object() : nullptr;
+		if (obj) return obj;
+
+		if (expected) error("Expected expression", position());
+		return nullptr;
+	}
+
+	ast_node* script_parser::parse_accessor_chain(ast_node* value) {
+		tokenizer& t = m_tokens;
+		ast_node* access = nullptr;
+		auto add = [&access, value, this](ast_node* accessor) {
+			if (!access) {
+				access = m_tree.node(ast_node_type::nt_access);
+				access->children.push_back(value);
+			}
+			access->children.push_back(accessor);
+		};
+
+		while (true) {
+			char c = t.peek();
+			token prop_access = c == '.' ? t.character('.', false) : token();
+			if (prop_access.valid()) {
+				ast_node* member = m_tree.node(ast_node_type::nt_member, t.identifier());
+				member->open = prop_access;
+
+				t.backup_state();
+				member->close = t.keyword(false, "=");
+				t.restore_state();
+
+				add(member);
+				if (member->close.valid()) break;
+				continue;
+			}
+
+			token prop_index = c == '[' ? t.character('[', false) : token();
+			if (prop_index.valid()) {
+				ast_node* index = m_tree.node(ast_node_type::nt_index);
+				index->open = prop_index;
+				index->children.push_back(parse_expression(true));
+				index->close = t.character(']');
+
+				t.backup_state();
+				index->tok = t.keyword(false, "=");
+				t.restore_state();
+
+				add(index);
+				if (index->tok.valid()) break;
+				continue;
+			}
+
+			// maybe function call?
+			if (c != '(') break;
+
+			ast_node* call = m_tree.node(ast_node_type::nt_call);
+			call->open = t.character('(');
+
+			token pclose;
+			token comma;
+			for (u16 p = 0;p < 128;p++) {
+				if (p >= 8) error("Functions can only have up to 8 parameters", comma);
+
+				pclose = t.character(')', !comma.valid() && p > 0);
+				if (pclose.valid()) break;
+
+				ast_node* arg = parse_expression(true);
+				comma = t.character(',', false);
+				arg->tok = comma;
+				call->children.push_back(arg);
+			}
+			call->close = pclose;
+
+			add(call);
+		}
+
+		return access ? access : value;
+	}
+
+	ast_node* script_parser::parse_object() {
+		tokenizer& t = m_tokens;
+		t.backup_state();
+		token obj_open = t.character('{', false);
+		if (!obj_open.valid()) {
+			t.restore_state();
+			return nullptr;
+		}
+
+		ast_node* obj = m_tree.node(ast_node_type::nt_object);
+		obj->open = obj_open;
+
+		token obj_close = t.character('}', false);
+		while (!t.at_end() && !obj_close.valid()) {
+			token propName = t.identifier(false);
+			if (!propName.valid()) propName = t.number_constant(false);
+			if (!propName.valid()) propName = t.string_constant(false, true, false);
+			if (!propName.valid()) {
+				// can only happen if this isn't a JSON object
+				t.restore_state();
+				return nullptr;
+			}
+
+			token assign = t.character(':', false);
+			if (!assign.valid()) {
+				// can only happen if this isn't a JSON object
+				t.restore_state();
+				return nullptr;
+			}
+
+			ast_node* prop = m_tree.node(ast_node_type::nt_property, propName);
+			prop->open = assign;
+			prop->children.push_back(parse_expression(true));
+			obj->children.push_back(prop);
+
+			t.character(',', false);
+			obj_close = t.character('}', false);
+		}
+
+		if (!obj_close.valid()) error("Encountered unexpected end of input while parsing object body", obj_open);
+
+		t.commit_state();
+		obj->close = obj_close;
+		return obj;
+	}
+};
\ No newline at end of file
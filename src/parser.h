@@ -0,0 +1,45 @@
+#pragma once
+#include <defs.h>
+#include <ast.h>
+#include <parse_utils.h>
+
+#include <string>
+
+namespace rs {
+	// builds a syntax tree from code in one pass over its tokens. it only checks
+	// the syntax, the compiler reports errors that depend on what's declared
+	class script_parser {
+		public:
+			script_parser(tokenizer& t, syntax_tree& tree);
+			~script_parser();
+
+			// throws parse_exception
+			void parse();
+
+			// the keywords that tokenizers for scripts should recognize
+			static const keyword_set& keywords();
+
+		protected:
+			tokenizer& m_tokens;
+			syntax_tree& m_tree;
+
+			// the current position, as a token with no text
+			tokenizer::token position();
+			void error(const std::string& text, const tokenizer::token& at);
+
+			// returns null for statements that compile to nothing
+			ast_node* parse_statement(bool parseSemicolon = true);
+			// parses the statements after 'open' up to the closing brace
+			ast_node* parse_block(const tokenizer::token& open, const char* error_text);
+			// 'body' is a block when it starts with a brace, otherwise it's a single
+			// statement that ends with a semicolon when 'parseSemicolon' is set
+			ast_node* parse_body(bool parseSemicolon, const char* error_text);
+			ast_node* parse_function(bool allow_name = true);
+			ast_node* parse_class(const tokenizer::token& kw);
+			ast_node* parse_expression(bool expected);
+			ast_node* parse_value(bool expected);
+			ast_node* parse_operator();
+			ast_node* parse_accessor_chain(ast_node* value);
+			ast_node* parse_object();
+	};
+};
\ No newline at end of file
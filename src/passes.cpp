@@ -0,0 +1,340 @@
+#include <passes.h>
+#include <compiler.h>
+#include <context.h>
+using namespace std;
+
+namespace rs {
+	compiler_pass::compiler_pass(context* ctx) {
+		m_context = ctx;
+	}
+
+	compiler_pass::~compiler_pass() {
+	}
+
+
+
+	pass_manager::pass_manager() {
+	}
+
+	pass_manager::~pass_manager() {
+		for (compiler_pass* pass : m_passes) delete pass;
+		m_passes.clear();
+	}
+
+	void pass_manager::add(compiler_pass* pass) {
+		m_passes.push_back(pass);
+	}
+
+	void pass_manager::execute(syntax_tree& tree) {
+		for (compiler_pass* pass : m_passes) pass->execute(tree);
+	}
+
+
+
+	unreachable_code_pass::unreachable_code_pass(context* ctx) : compiler_pass(ctx) {
+	}
+
+	void unreachable_code_pass::execute(syntax_tree& tree) {
+		visit(tree.root);
+	}
+
+	void unreachable_code_pass::visit(ast_node* node) {
+		if (!node) return;
+
+		if (node->type == ast_node_type::nt_block) {
+			vector<ast_node*> reachable;
+			bool returned = false;
+			for (ast_node* statement : node->children) {
+				if (!returned || declares_function(statement)) reachable.push_back(statement);
+				if (statement->type == ast_node_type::nt_return) returned = true;
+			}
+			node->children = reachable;
+		}
+
+		for (ast_node* child : node->children) visit(child);
+	}
+
+	bool unreachable_code_pass::declares_function(ast_node* node) {
+		if (!node) return false;
+		if (node->type == ast_node_type::nt_function) return true;
+
+		for (ast_node* child : node->children) {
+			if (declares_function(child)) return true;
+		}
+
+		return false;
+	}
+
+
+
+	constant_folding_pass::constant_folding_pass(context* ctx) : compiler_pass(ctx) {
+		m_tree = nullptr;
+	}
+
+	void constant_folding_pass::execute(syntax_tree& tree) {
+		m_tree = &tree;
+		m_scopes.push_back(vector<constant>());
+		for (ast_node* statement : tree.root->children) this->statement(statement);
+		m_scopes.clear();
+		m_tree = nullptr;
+	}
+
+	variable_id constant_folding_pass::lookup(const string& name) {
+		for (auto i = m_scopes.rbegin();i != m_scopes.rend();i++) {
+			for (auto& c : *i) {
+				if (c.name == name) return c.value;
+			}
+		}
+
+		return 0;
+	}
+
+	bool constant_folding_pass::is_number(variable_id id) {
+		context_memory::slot* s = m_context->memory->at(id);
+		if (!s || !(s->flags & context_memory::sf_static)) return false;
+		return s->type == rs_builtin_type::t_integer || s->type == rs_builtin_type::t_decimal;
+	}
+
+	// evaluates 'op' on two static numbers the same way that the number
+	// instruction set would. returns a static variable holding the result, or 0
+	// if the instruction should be left for runtime
+	variable_id constant_folding_pass::fold(rs_instruction op, variable_id a_id, variable_id b_id) {
+		context_memory::mem_var a = m_context->memory->get(a_id);
+		context_memory::mem_var b = m_context->memory->get(b_id);
+		type_id type = a.type > b.type ? a.type : b.type;
+		bool comparison = op == rs_instruction::less || op == rs_instruction::greater || op == rs_instruction::lessEq || op == rs_instruction::greaterEq || op == rs_instruction::compare;
+
+		u8 cmp = 0;
+		if (type == rs_builtin_type::t_integer) {
+			integer_type av = *(integer_type*)a.data;
+			integer_type bv = *(integer_type*)b.data;
+			integer_type result = 0;
+			switch (op) {
+				case rs_instruction::add: { result = av + bv; break; }
+				case rs_instruction::sub: { result = av - bv; break; }
+				case rs_instruction::mul: { result = av * bv; break; }
+				case rs_instruction::div: {
+					if (bv == 0 || (av == rs_integer_min && bv == -1)) return 0;
+					result = av / bv;
+					break;
+				}
+				case rs_instruction::mod: {
+					if (bv == 0 || (av == rs_integer_min && bv == -1)) return 0;
+					result = av % bv;
+					break;
+				}
+				case rs_instruction::pow: {
+					// negative exponents take a decimal path at runtime
+					if (bv < 0) return 0;
+					result = 1;
+					for (;bv;bv >>= 1) {
+						if (bv & 1) result *= av;
+						av *= av;
+					}
+					break;
+				}
+				case rs_instruction::less: { cmp = av < bv ? 1 : 0; break; }
+				case rs_instruction::greater: { cmp = av > bv ? 1 : 0; break; }
+				case rs_instruction::lessEq: { cmp = av <= bv ? 1 : 0; break; }
+				case rs_instruction::greaterEq: { cmp = av >= bv ? 1 : 0; break; }
+				case rs_instruction::compare: { cmp = av == bv ? 1 : 0; break; }
+				default: return 0;
+			}
+
+			if (!comparison) return m_context->memory->set_static(type, sizeof(integer_type), &result);
+		} else {
+			decimal_type av = a.type == rs_builtin_type::t_integer ? decimal_type(*(integer_type*)a.data) : *(decimal_type*)a.data;
+			decimal_type bv = b.type == rs_builtin_type::t_integer ? decimal_type(*(integer_type*)b.data) : *(decimal_type*)b.data;
+			decimal_type result = 0;
+			switch (op) {
+				case rs_instruction::add: { result = av + bv; break; }
+				case rs_instruction::sub: { result = av - bv; break; }
+				case rs_instruction::mul: { result = av * bv; break; }
+				case rs_instruction::div: { result = av / bv; break; }
+				case rs_instruction::mod: { result = fmod(av, bv); break; }
+				case rs_instruction::pow: { result = ::pow(av, bv); break; }
+				case rs_instruction::less: { cmp = av < bv ? 1 : 0; break; }
+				case rs_instruction::greater: { cmp = av > bv ? 1 : 0; break; }
+				case rs_instruction::lessEq: { cmp = av <= bv ? 1 : 0; break; }
+				case rs_instruction::greaterEq: { cmp = av >= bv ? 1 : 0; break; }
+				case rs_instruction::compare: { cmp = av == bv ? 1 : 0; break; }
+				default: return 0;
+			}
+
+			if (!comparison) return m_context->memory->set_static(type, sizeof(decimal_type), &result);
+		}
+
+		return m_context->memory->set_static(rs_builtin_type::t_bool, sizeof(u8), &cmp);
+	}
+
+	void constant_folding_pass::statement(ast_node* node) {
+		if (!node) return;
+
+		auto& c = node->children;
+		switch (node->type) {
+			case ast_node_type::nt_expression: {
+				expression(node, false);
+				break;
+			}
+			case ast_node_type::nt_return: {
+				if (c.size() > 0) expression(c[0], false);
+				break;
+			}
+			case ast_node_type::nt_if: {
+				expression(c[0], false);
+				body(c[1]);
+				if (c.size() > 2) body(c[2]);
+				break;
+			}
+			case ast_node_type::nt_while: {
+				expression(c[0], false);
+				body(c[1]);
+				break;
+			}
+			case ast_node_type::nt_for: {
+				// the compiler doesn't end the scope that a for loop starts
+				m_scopes.push_back(vector<constant>());
+				statement(c[0]);
+				if (c[1]) expression(c[1], false);
+				statement(c[2]);
+				if (c[3]->type == ast_node_type::nt_block) {
+					for (ast_node* s : c[3]->children) statement(s);
+				} else body(c[3]);
+				break;
+			}
+			case ast_node_type::nt_const: {
+				m_scopes.back().push_back({ node->tok.text, 0 });
+				if (c.size() == 0) break;
+				expression(c[0], false);
+
+				// 'name = number'
+				auto& init = c[0]->children;
+				if (init.size() != 2 || init[0]->type != ast_node_type::nt_identifier) break;
+				if (init[1]->type != ast_node_type::nt_operator || init[1]->op != rs_instruction::store) break;
+				if (!m_scopes.back().empty()) m_scopes.back().back().value = init[1]->children[0]->value;
+				break;
+			}
+			case ast_node_type::nt_let: {
+				m_scopes.back().push_back({ node->tok.text, 0 });
+				if (c.size() > 0) expression(c[0], false);
+				break;
+			}
+			case ast_node_type::nt_class: {
+				for (ast_node* member : c) {
+					if (member->type == ast_node_type::nt_function) function(member);
+					else if (member->children.size() == 0) continue;
+					else if (member->children[0]->type == ast_node_type::nt_function) function(member->children[0]);
+					else expression(member->children[0], false);
+				}
+				break;
+			}
+			case ast_node_type::nt_function: {
+				function(node);
+				break;
+			}
+			default: break;
+		}
+	}
+
+	void constant_folding_pass::body(ast_node* node) {
+		if (node->type == ast_node_type::nt_block) {
+			m_scopes.push_back(vector<constant>());
+			for (ast_node* s : node->children) statement(s);
+			m_scopes.pop_back();
+		} else {
+			for (ast_node* s : node->children) statement(s);
+		}
+	}
+
+	void constant_folding_pass::function(ast_node* node) {
+		m_scopes.push_back(vector<constant>());
+		for (size_t i = 0;i < node->children.size() - 1;i++) {
+			m_scopes.back().push_back({ node->children[i]->tok.text, 0 });
+		}
+
+		for (ast_node* s : node->children.back()->children) statement(s);
+		m_scopes.pop_back();
+	}
+
+	variable_id constant_folding_pass::expression(ast_node* node, bool in_lvalue) {
+		auto& c = node->children;
+
+		// the first operand is always loaded into lvalue
+		variable_id lhs_constant = value(c[0], true);
+
+		vector<ast_node*> ops;
+		ops.push_back(c[0]);
+		for (size_t i = 1;i < c.size();i++) {
+			ast_node* op = c[i];
+			variable_id rhs_constant = op->children.size() > 0 ? value(op->children[0], false) : 0;
+
+			variable_id folded = 0;
+			if (lhs_constant && rhs_constant && !is_assignment(op->op)) folded = fold(op->op, lhs_constant, rhs_constant);
+
+			if (folded) {
+				// operators that fold one after another leave only the last result
+				ast_node* result = ops.back();
+				if (result->type != ast_node_type::nt_folded) {
+					result = m_tree->node(ast_node_type::nt_folded);
+					ops.push_back(result);
+				}
+
+				result->tok = op->tok;
+				result->close = op->close;
+				result->op = op->op;
+				result->value = folded;
+				lhs_constant = is_number(folded) ? folded : 0;
+				continue;
+			}
+
+			ops.push_back(op);
+
+			// store leaves the number that was stored as the result, which is moved
+			// into lvalue for the next operator unless the result is already there
+			lhs_constant = op->op == rs_instruction::store && !in_lvalue ? rhs_constant : 0;
+		}
+		c = ops;
+
+		if (c.size() == 1) return lhs_constant;
+		if (c.size() == 2 && c[1]->type == ast_node_type::nt_folded && is_number(c[1]->value)) return c[1]->value;
+		return 0;
+	}
+
+	variable_id constant_folding_pass::value(ast_node* node, bool in_lvalue) {
+		auto& c = node->children;
+		switch (node->type) {
+			case ast_node_type::nt_number: {
+				node->value = define_static_number(m_context, node->tok);
+				return node->value;
+			}
+			case ast_node_type::nt_identifier: {
+				node->value = lookup(node->tok.text);
+				return node->value;
+			}
+			case ast_node_type::nt_parenthesis: {
+				node->value = expression(c[0], in_lvalue);
+				return node->value;
+			}
+			case ast_node_type::nt_access: {
+				value(c[0], in_lvalue);
+				for (size_t i = 1;i < c.size();i++) {
+					for (ast_node* e : c[i]->children) expression(e, false);
+				}
+				return 0;
+			}
+			case ast_node_type::nt_new: {
+				value(c[0], false);
+				return 0;
+			}
+			case ast_node_type::nt_function: {
+				function(node);
+				return 0;
+			}
+			case ast_node_type::nt_object: {
+				for (ast_node* prop : c) expression(prop->children[0], false);
+				return 0;
+			}
+			default: return 0;
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <defs.h>
+#include <ast.h>
+
+#include <string>
+#include <vector>
+
+namespace rs {
+	// transforms the syntax tree of a piece of code before instructions are
+	// generated from it
+	class compiler_pass {
+		public:
+			compiler_pass(context* ctx);
+			virtual ~compiler_pass();
+
+			virtual void execute(syntax_tree& tree) = 0;
+
+		protected:
+			context* m_context;
+	};
+
+	// runs passes in the order they were added, and deletes them
+	class pass_manager {
+		public:
+			pass_manager();
+			~pass_manager();
+
+			void add(compiler_pass* pass);
+			void execute(syntax_tree& tree);
+
+		protected:
+			std::vector<compiler_pass*> m_passes;
+	};
+
+	// removes the statements in a block that follow a return. statements that
+	// declare functions are kept, those could be called from somewhere else
+	class unreachable_code_pass : public compiler_pass {
+		public:
+			unreachable_code_pass(context* ctx);
+
+			virtual void execute(syntax_tree& tree);
+
+		protected:
+			void visit(ast_node* node);
+			bool declares_function(ast_node* node);
+	};
+
+	// evaluates operators that have numbers on both sides, and replaces
+	// references to constants that were initialized with a number by the number.
+	// what's replaced mirrors what the compiler would emit for each node
+	class constant_folding_pass : public compiler_pass {
+		public:
+			constant_folding_pass(context* ctx);
+
+			virtual void execute(syntax_tree& tree);
+
+		protected:
+			struct constant {
+				std::string name;
+				variable_id value;
+			};
+
+			syntax_tree* m_tree;
+			// declarations in scope, the same way the compiler tracks them
+			std::vector<std::vector<constant>> m_scopes;
+
+			variable_id lookup(const std::string& name);
+			bool is_number(variable_id id);
+			variable_id fold(rs_instruction op, variable_id a, variable_id b);
+
+			void statement(ast_node* node);
+			void body(ast_node* node);
+			void function(ast_node* node);
+			// these return the number that the node loads, or 0. 'in_lvalue' is set
+			// when the node is the first operand of an expression, which is kept in
+			// lvalue
+			variable_id expression(ast_node* node, bool in_lvalue);
+			variable_id value(ast_node* node, bool in_lvalue);
+	};
+};
\ No newline at end of file
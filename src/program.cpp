@@ -0,0 +1,16 @@
+#include <program.h>
+using namespace std;
+
+namespace rs {
+	program::program(context* ctx, bool heap) {
+		vector<u8> data;
+		m_image.name = "program";
+		m_valid = write_module(ctx, data, m_image.name, heap) && read_module_image(data, m_image.name, m_image);
+	}
+
+	program::program(const string& path) {
+		vector<u8> data;
+		m_image.name = path;
+		m_valid = read_module_file(path, data) && read_module_image(data, path, m_image);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+#include <defs.h>
+#include <module.h>
+#include <string>
+#include <vector>
+
+namespace rs {
+	class context;
+
+	// compiled code that any number of contexts can load at the same time, on
+	// any thread. it's a module (see module.h) that is read and checked once,
+	// when the program is created, and it never changes after that, so it can
+	// be shared without locking. a context that loads it before compiling
+	// anything runs the program's instructions where they are, only the
+	// constants, property caches, functions, prototypes and variables that
+	// refer to its own memory are made for each context. a program must
+	// outlive the contexts that load it
+	class program {
+		public:
+			// everything that has been compiled in 'ctx'. if 'heap' is true the
+			// values of its variables are kept as well, and contexts that load
+			// the program start from them instead of running the top level code
+			program(context* ctx, bool heap);
+			// a module or snapshot file
+			program(const std::string& path);
+
+			inline bool valid() const { return m_valid; }
+			inline bool has_heap() const { return m_valid && m_image.header.has_heap; }
+			inline const std::string& name() const { return m_image.name; }
+			inline const module_image& image() const { return m_image; }
+
+		protected:
+			module_image m_image;
+			bool m_valid;
+	};
+};
\ No newline at end of file
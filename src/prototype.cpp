@@ -5,21 +5,23 @@
 using namespace std;
 
 namespace rs {
-	static type_id next_type_id = rs_builtin_type::script_type_base + 1;
-
 	object_prototype::object_prototype(context* ctx, const string& name) {
+		m_context = ctx;
 		m_id = ctx->memory->set(rs_builtin_type::t_class, sizeof(object_prototype*), this);
 		m_declaration = { 0, 0, name, "internal" };
-		m_type_id = next_type_id++;
+		m_type_id = ctx->gen_type_id();
 		m_constructor = nullptr;
+		m_shape = new object_shape(this);
 		parent = nullptr;
 	}
 
 	object_prototype::object_prototype(context* ctx, const tokenizer::token& declaration) {
+		m_context = ctx;
 		m_id = ctx->memory->set(rs_builtin_type::t_class, sizeof(object_prototype*), this);
 		m_declaration = declaration;
-		m_type_id = next_type_id++;
+		m_type_id = ctx->gen_type_id();
 		m_constructor = nullptr;
+		m_shape = new object_shape(this);
 		parent = nullptr;
 	}
 
@@ -27,28 +29,49 @@ namespace rs {
 		m_methods.clear();
 		m_static_methods.clear();
 		m_static_vars.clear();
+		delete m_shape;
 	}
 	
 	script_object* object_prototype::create(context* ctx, variable_id* args, u8 arg_count) {
 		script_object* obj = new script_object(ctx);
 		obj->set_id(ctx->memory->set(rs_builtin_type::t_object, sizeof(script_object*), obj));
+		// the caller holds on to obj, so its variable stays a root
+		ctx->gc->track(obj, false);
 		obj->add_prototype(this, true, args, arg_count);
 		return obj;
 	}
 
 	script_function* object_prototype::method(const string& name) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom) return nullptr;
+		return method(atom);
+	}
+
+	script_function* object_prototype::method(atom_id name) {
 		if (m_methods.has(name)) return *m_methods.get(name);
 		if (parent) return parent->method(name);
 		return nullptr;
 	}
 
 	script_function* object_prototype::static_method(const string& name) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom) return nullptr;
+		return static_method(atom);
+	}
+
+	script_function* object_prototype::static_method(atom_id name) {
 		if (m_static_methods.has(name)) return *m_static_methods.get(name);
 		if (parent) return parent->static_method(name);
 		return nullptr;
 	}
 
 	variable_id object_prototype::static_variable(const string& name) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom) return 0;
+		return static_variable(atom);
+	}
+
+	variable_id object_prototype::static_variable(atom_id name) {
 		if (m_static_vars.has(name)) return *m_static_vars.get(name);
 		if (parent) return parent->static_variable(name);
 		return 0;
@@ -60,16 +83,20 @@ namespace rs {
 	}
 
 	object_prototype* object_prototype::method(script_function* func) {
-		m_methods.set(func->name.text, func);
+		m_methods.set(m_context->atoms->get(func->name.text), func);
 		return this;
 	}
 
 	object_prototype* object_prototype::static_method(script_function* func) {
-		m_static_methods.set(func->name.text, func);
+		m_static_methods.set(m_context->atoms->get(func->name.text), func);
 		return this;
 	}
 
 	object_prototype* object_prototype::static_variable(const string& name, variable_id id) {
+		return static_variable(m_context->atoms->get(name), id);
+	}
+
+	object_prototype* object_prototype::static_variable(atom_id name, variable_id id) {
 		m_static_vars.set(name, id);
 		return this;
 	}
@@ -2,6 +2,7 @@
 #include <defs.h>
 #include <dynamic_array.hpp>
 #include <parse_utils.h>
+#include <shape.h>
 #include <string>
 
 namespace rs {
@@ -19,26 +20,39 @@ namespace rs {
 			inline const tokenizer::token declaration() { return m_declaration; }
 			inline const type_id type() const { return m_type_id; }
 			inline const variable_id id() const { return m_id; }
+			// shape of instances that have no properties of their own
+			inline object_shape* shape() { return m_shape; }
 
 			inline script_function* constructor() { return m_constructor; }
 			script_function* method(const std::string& name);
+			script_function* method(atom_id name);
 			script_function* static_method(const std::string& name);
+			script_function* static_method(atom_id name);
 			variable_id static_variable(const std::string& name);
+			variable_id static_variable(atom_id name);
 
 			object_prototype* constructor(script_function* func);
 			object_prototype* method(script_function* func);
 			object_prototype* static_method(script_function* func);
 			object_prototype* static_variable(const std::string& name, variable_id id);
+			object_prototype* static_variable(atom_id name, variable_id id);
+
+			// names of what this prototype defines itself, not what it inherits
+			inline mvector<atom_id> method_names() const { return m_methods.keys(); }
+			inline mvector<atom_id> static_method_names() const { return m_static_methods.keys(); }
+			inline mvector<atom_id> static_variable_names() const { return m_static_vars.keys(); }
 
 			object_prototype* parent;
 
 		protected:
+			context* m_context;
 			variable_id m_id;
 			type_id m_type_id;
 			tokenizer::token m_declaration;
-			associative_pod_array<std::string, script_function*> m_methods;
-			associative_pod_array<std::string, script_function*> m_static_methods;
-			associative_pod_array<std::string, variable_id> m_static_vars;
+			associative_pod_array<atom_id, script_function*> m_methods;
+			associative_pod_array<atom_id, script_function*> m_static_methods;
+			associative_pod_array<atom_id, variable_id> m_static_vars;
 			script_function* m_constructor;
+			object_shape* m_shape;
 	};
 };
\ No newline at end of file
@@ -7,6 +7,7 @@ namespace rs {
 		m_ctx = ctx;
 		name = _name;
 		cpp_callback = nullptr;
+		cpp_target = nullptr;
 		entry_point_id = entry_id;
 		entry_point = *(u64*)ctx->memory->get(entry_id).data;
 		exit_point = entry_point + instruction_count;
@@ -16,6 +17,7 @@ namespace rs {
 		m_ctx = ctx;
 		name = { 0, 0, _name, "internal" };
 		cpp_callback = cb;
+		cpp_target = nullptr;
 		entry_point_id = 0;
 		entry_point = 0;
 		exit_point = 0;
@@ -23,4 +25,12 @@ namespace rs {
 
 	script_function::~script_function() {
 	}
+
+
+
+	void native_argument_error(func_args* args, u8 idx, const char* expected) {
+		string error = format("Argument %d of '%s' should be %s", idx + 1, args->function->name.text.c_str(), expected);
+		if (args->state) throw runtime_exception(error, args->state);
+		throw runtime_exception(error);
+	}
 };
@@ -4,21 +4,57 @@
 #include <dynamic_array.hpp>
 #include <context_memory.h>
 #include <context.h>
+#include <execution_state.h>
+#include <script_object.h>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace rs {
 	class context;
 	class script_object;
 	class execution_state;
 
+	class script_function;
+
 	struct func_args {
 		script_object* self;
 		context* context;
 		execution_state* state;
+		// the function that was called
+		script_function* function;
 		struct arg {
 			context_memory::mem_var var;
 			variable_id id;
 		};
-		dynamic_pod_array<arg> parameters;
+
+		// the arguments that were passed, which aren't copied. their values are
+		// only looked up when they're asked for
+		class arg_span {
+			public:
+				arg_span(context_memory* memory, const variable_id* ids, u8 count) : m_memory(memory), m_ids(ids), m_count(count) { }
+
+				inline u8 size() const { return m_count; }
+				inline variable_id id(u8 idx) const { return m_ids[idx]; }
+				inline context_memory::mem_var value(u8 idx) const { return m_memory->get(m_ids[idx]); }
+
+				// stops when 'callback' returns false, like dynamic_pod_array::for_each
+				template <typename F>
+				size_t for_each(F&& callback) const {
+					for (u8 i = 0;i < m_count;i++) {
+						arg a = { m_memory->get(m_ids[i]), m_ids[i] };
+						if (!callback(&a)) return i + 1;
+					}
+					return m_count;
+				}
+
+			protected:
+				context_memory* m_memory;
+				const variable_id* m_ids;
+				u8 m_count;
+		};
+		arg_span parameters;
 	};
 
 	class script_function {
@@ -37,8 +73,144 @@ namespace rs {
 			std::vector<variable> params;
 
 			script_function_callback cpp_callback;
+			// the c++ function that a typed binding calls once cpp_callback has
+			// converted the arguments, see context::bind_function
+			void (*cpp_target)();
 
 		protected:
 			context* m_ctx;
 	};
+
+	// throws the error for an argument of a typed binding that can't be converted
+	void native_argument_error(func_args* args, u8 idx, const char* expected);
+
+	// stores the result of a typed binding in a variable for the return_value register.
+	// when called from a script the frame's temporaries are reused. it's inline
+	// because it's called for every result
+	inline variable_id native_result(func_args* args, type_id type, size_t size, void* data) {
+		if (args->state) return args->state->temporary(rs_register::return_value, type, size, data);
+		return args->context->memory->set(type, size, data);
+	}
+
+	// how the arguments and results of typed bindings are converted. 'from' is given
+	// null if the argument wasn't passed, and returns false if the value can't be
+	// converted. types that aren't specialized here can't be used in bindings
+	template <typename T, typename = void>
+	struct native_type;
+
+	template <typename T>
+	struct native_type<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>> {
+		static constexpr const char* name = "a number";
+
+		static inline bool from(context_memory::slot* s, T& out) {
+			if (!s) return false;
+			if (s->type == rs_builtin_type::t_integer) out = T(*(integer_type*)s->data());
+			else if (s->type == rs_builtin_type::t_decimal) out = T(*(decimal_type*)s->data());
+			else return false;
+			return true;
+		}
+
+		static inline variable_id to(func_args* args, T value) {
+			if constexpr (std::is_integral_v<T>) {
+				integer_type v = integer_type(value);
+				return native_result(args, rs_builtin_type::t_integer, sizeof(integer_type), &v);
+			} else {
+				decimal_type v = decimal_type(value);
+				return native_result(args, rs_builtin_type::t_decimal, sizeof(decimal_type), &v);
+			}
+		}
+	};
+
+	template <>
+	struct native_type<bool> {
+		static constexpr const char* name = "a bool";
+
+		static inline bool from(context_memory::slot* s, bool& out) {
+			if (!s) return false;
+			if (s->type == rs_builtin_type::t_bool) out = *(u8*)s->data() != 0;
+			else if (s->type == rs_builtin_type::t_integer) out = *(integer_type*)s->data() != 0;
+			else if (s->type == rs_builtin_type::t_decimal) out = *(decimal_type*)s->data() != 0;
+			else return false;
+			return true;
+		}
+
+		static inline variable_id to(func_args* args, bool value) {
+			u8 v = value ? 1 : 0;
+			return native_result(args, rs_builtin_type::t_bool, 1, &v);
+		}
+	};
+
+	// strings are viewed in place, they aren't copied unless the binding takes a std::string
+	template <typename T>
+	struct native_type<T, std::enable_if_t<std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>>> {
+		static constexpr const char* name = "a string";
+
+		static inline bool from(context_memory::slot* s, T& out) {
+			if (!s || s->type != rs_builtin_type::t_string) return false;
+			out = T((const char*)s->data(), s->size);
+			return true;
+		}
+
+		static inline variable_id to(func_args* args, const T& value) {
+			char* str = new char[value.length()];
+			memcpy(str, value.data(), value.length());
+			return native_result(args, rs_builtin_type::t_string, value.length(), str);
+		}
+	};
+
+	// objects are passed as they are, null if the argument wasn't an object
+	template <>
+	struct native_type<script_object*> {
+		static constexpr const char* name = "an object";
+
+		static inline bool from(context_memory::slot* s, script_object*& out) {
+			if (!s || s->type == rs_builtin_type::t_null) out = nullptr;
+			else if (s->type == rs_builtin_type::t_object) out = (script_object*)s->data();
+			else return false;
+			return true;
+		}
+
+		static inline variable_id to(func_args*, script_object* value) {
+			return value ? value->id() : 0;
+		}
+	};
+
+	template <typename Sig>
+	struct native_binding;
+
+	// the script_function_callback that a typed binding is called through. each
+	// argument is converted for the parameter it's passed to, in order, then the
+	// c++ function is called directly and its result is converted back
+	template <typename R, typename... Args>
+	struct native_binding<R(Args...)> {
+		static_assert(sizeof...(Args) <= 8, "Functions can only have up to 8 parameters");
+
+		static variable_id call(func_args* args) {
+			return call(args, std::index_sequence_for<Args...>());
+		}
+
+		template <size_t... I>
+		static variable_id call(func_args* args, std::index_sequence<I...>) {
+			std::tuple<std::decay_t<Args>...> values;
+			(argument<I>(args, std::get<I>(values)), ...);
+
+			R (*fn)(Args...) = (R (*)(Args...))args->function->cpp_target;
+			if constexpr (std::is_void_v<R>) {
+				fn(std::get<I>(values)...);
+				return 0;
+			} else return native_type<std::decay_t<R>>::to(args, fn(std::get<I>(values)...));
+		}
+
+		template <size_t I, typename T>
+		static inline void argument(func_args* args, T& out) {
+			context_memory::slot* s = I < args->parameters.size() ? args->context->memory->at(args->parameters.id(I)) : nullptr;
+			if (!native_type<T>::from(s, out)) native_argument_error(args, I, native_type<T>::name);
+		}
+	};
+
+	template <typename Sig>
+	void context::bind_function(const std::string& name, Sig* fn) {
+		bind_function(name, native_binding<Sig>::call);
+		global_functions.back()->cpp_target = (void (*)())fn;
+	}
 };
@@ -8,45 +8,75 @@ namespace rs {
 	script_object::script_object(context* ctx) {
 		prototype = nullptr;
 		m_context = ctx;
+		m_shape = ctx->root_shape;
 		m_id = 0;
+		m_gc_epoch = 0;
 	}
 
 	script_object::~script_object() {
-		m_props.clear();
+		if (m_shape->is_dictionary()) delete m_shape;
+		m_slots.clear();
 	}
 
 	variable_id script_object::inject_property(const string& name, type_id type, size_t size, void* ptr) {
 		variable_id id = m_context->memory->inject(type, size, ptr);
-		m_props[name] = id;
+		set_property(m_context->atoms->get(name), id);
+		m_context->gc->add_property(this, id);
 		return id;
 	}
 
 	variable_id script_object::define_property(const string& name, type_id type, size_t size, void* data) {
+		return define_property(m_context->atoms->get(name), type, size, data);
+	}
+
+	variable_id script_object::define_property(atom_id name, type_id type, size_t size, void* data) {
+		variable_id id = m_context->memory->set(type, size, data);
+		set_property(name, id);
+		m_context->gc->add_property(this, id);
+		return id;
+	}
+
+	variable_id script_object::define_property(object_shape* transition, type_id type, size_t size, void* data) {
 		variable_id id = m_context->memory->set(type, size, data);
-		m_props[name] = id;
+		m_shape = transition;
+		m_slots.push_back(id);
+		m_context->gc->add_property(this, id);
 		return id;
 	}
 
 	void script_object::delete_property(const string& name) {
-		auto& p = m_props.find(name);
-		if (p == m_props.end()) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom || m_shape->index(atom) == -1) {
 			// throw runtime exception
 			return;
 		}
 
-		m_props.erase(p);
+		reshape(m_shape->root(), atom);
 	}
 
 	variable_id script_object::property(const string& name) {
-		auto& p = m_props.find(name);
-		if (p == m_props.end()) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom) return 0;
+		return property(atom);
+	}
+
+	variable_id script_object::property(atom_id name) {
+		i32 idx = m_shape->index(name);
+		if (idx == -1) {
 			return 0;
 		}
 
-		return p->second;
+		return m_slots[idx];
 	}
 
 	variable_id script_object::proto_property(const string& name) {
+		atom_id atom = m_context->atoms->find(name);
+		if (!atom) return 0;
+		return proto_property(atom);
+	}
+
+	variable_id script_object::proto_property(atom_id name) {
+		if (!prototype) return 0;
 		script_function* method = prototype->method(name);
 		if (method) {
 			return method->function_id;
@@ -57,6 +87,7 @@ namespace rs {
 
 	void script_object::add_prototype(object_prototype* _prototype, bool call_constructor, variable_id* args, u8 arg_count) {
 		prototype = _prototype;
+		if (m_shape->prototype() != prototype) reshape(prototype->shape(), 0);
 		if (call_constructor) {
 			auto constructor = prototype->constructor();
 			if (constructor) {
@@ -68,7 +99,32 @@ namespace rs {
 
 	vector<script_object::prop> script_object::properties() const {
 		vector<prop> props;
-		for (auto& p : m_props) props.push_back({ p.second, p.first });
+		for (u32 p = 0;p < m_shape->count();p++) props.push_back({ m_slots[p], m_context->atoms->str(m_shape->name(p)) });
 		return props;
 	}
+
+	void script_object::set_property(atom_id name, variable_id id) {
+		i32 idx = m_shape->index(name);
+		if (idx != -1) {
+			m_slots[idx] = id;
+			return;
+		}
+
+		m_shape = m_shape->add(name);
+		m_slots.push_back(id);
+	}
+
+	void script_object::reshape(object_shape* root, atom_id skip) {
+		object_shape* shape = root;
+		vector<variable_id> slots;
+		for (u32 p = 0;p < m_shape->count();p++) {
+			if (m_shape->name(p) == skip) continue;
+			shape = shape->add(m_shape->name(p));
+			slots.push_back(m_slots[p]);
+		}
+
+		if (m_shape->is_dictionary()) delete m_shape;
+		m_shape = shape;
+		m_slots = slots;
+	}
 };
\ No newline at end of file
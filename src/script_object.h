@@ -1,6 +1,7 @@
 #pragma once
 #include <defs.h>
 #include <context.h>
+#include <shape.h>
 
 namespace rs {
 	class object_prototype;
@@ -15,10 +16,15 @@ namespace rs {
 			variable_id inject_property(const std::string& name, type_id type, size_t size, void* ptr);
 
 			variable_id define_property(const std::string& name, type_id type, size_t size, void* data);
+			variable_id define_property(atom_id name, type_id type, size_t size, void* data);
+			// defines the property that 'transition' adds to this object's shape
+			variable_id define_property(object_shape* transition, type_id type, size_t size, void* data);
 			void delete_property(const std::string& name);
 
 			variable_id property(const std::string& name);
+			variable_id property(atom_id name);
 			variable_id proto_property(const std::string& name);
+			variable_id proto_property(atom_id name);
 
 			void add_prototype(object_prototype* prototype, bool call_constructor, variable_id* args, u8 arg_count);
 
@@ -28,6 +34,8 @@ namespace rs {
 			};
 			std::vector<prop> properties() const;
 			inline context* ctx() { return m_context; }
+			inline object_shape* shape() const { return m_shape; }
+			inline variable_id slot(u32 idx) const { return m_slots[idx]; }
 			inline variable_id id() { return m_id; }
 			inline bool set_id(variable_id id) {
 				if (!m_id) {
@@ -40,16 +48,25 @@ namespace rs {
 			object_prototype* prototype;
 
 		protected:
-			munordered_map<std::string, variable_id> m_props;
+			friend class garbage_collector;
+			void set_property(atom_id name, variable_id id);
+			// moves the properties to a shape that starts at 'root', leaving 'skip' out
+			void reshape(object_shape* root, atom_id skip);
+
+			object_shape* m_shape;
+			// property ids, in the order of m_shape's slots
+			std::vector<variable_id> m_slots;
 			context* m_context;
 			variable_id m_id;
+			u32 m_gc_epoch;
 	};
 
 	template<typename T, typename U>
 	variable_id script_object::inject_property(void* self, const std::string& name, type_id type, U T::*member) {
 		size_t offset = (char*)&((T*)nullptr->*member) - (char*)nullptr;
 		variable_id id = m_context->memory->inject(type, sizeof(U), ((u8*)self) + offset);
-		m_props[name] = id;
+		set_property(m_context->atoms->get(name), id);
+		m_context->gc->add_property(this, id);
 		return id;
 	}
 };
\ No newline at end of file
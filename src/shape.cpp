@@ -0,0 +1,59 @@
+#include <shape.h>
+using namespace std;
+
+namespace rs {
+	// objects that gain more properties than this are given a dictionary shape,
+	// so that building large objects doesn't leave a long chain of shapes behind
+	static const u32 max_shared_properties = 32;
+
+	object_shape::object_shape(object_prototype* prototype) {
+		m_prototype = prototype;
+		m_root = this;
+		m_dictionary = false;
+	}
+
+	object_shape::object_shape(const object_shape* parent, atom_id name) {
+		m_prototype = parent->m_prototype;
+		m_root = parent->m_root;
+		m_dictionary = false;
+		m_names = parent->m_names;
+		m_indices = parent->m_indices;
+		m_indices[name] = u32(m_names.size());
+		m_names.push_back(name);
+	}
+
+	object_shape::~object_shape() {
+		for (auto& t : m_transitions) delete t.second;
+		m_transitions.clear();
+	}
+
+	object_shape* object_shape::add(atom_id name) {
+		if (m_dictionary) {
+			if (m_indices.count(name) == 0) {
+				m_indices[name] = u32(m_names.size());
+				m_names.push_back(name);
+			}
+			return this;
+		}
+
+		if (m_indices.count(name) > 0) return this;
+
+		auto t = m_transitions.find(name);
+		if (t != m_transitions.end()) return t->second;
+
+		if (m_names.size() >= max_shared_properties) return to_dictionary()->add(name);
+
+		object_shape* shape = new object_shape(this, name);
+		m_transitions[name] = shape;
+		return shape;
+	}
+
+	object_shape* object_shape::to_dictionary() const {
+		object_shape* shape = new object_shape(m_prototype);
+		shape->m_root = m_root;
+		shape->m_dictionary = true;
+		shape->m_names = m_names;
+		shape->m_indices = m_indices;
+		return shape;
+	}
+};
\ No newline at end of file
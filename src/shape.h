@@ -0,0 +1,82 @@
+#pragma once
+#include <defs.h>
+#include <vector>
+
+namespace rs {
+	class object_prototype;
+
+	// describes which properties an object has and which slot each of them is
+	// stored in. objects with the same prototype that gained the same properties
+	// in the same order share a shape, so a shape and a slot index can stand in
+	// for a property lookup by name
+	class object_shape {
+		public:
+			// root shape, for objects of 'prototype' that have no properties
+			object_shape(object_prototype* prototype);
+			~object_shape();
+
+			// returns the slot index of 'name', or -1
+			inline i32 index(atom_id name) const {
+				auto it = m_indices.find(name);
+				if (it == m_indices.end()) return -1;
+				return it->second;
+			}
+
+			// returns the shape of an object with this shape that gains 'name'.
+			// dictionary shapes are modified and returned
+			object_shape* add(atom_id name);
+
+			// returns a dictionary shape with the same properties as this one
+			object_shape* to_dictionary() const;
+
+			// dictionary shapes belong to a single object and are modified in place,
+			// so they can't be cached
+			inline bool is_dictionary() const { return m_dictionary; }
+			inline object_shape* root() const { return m_root; }
+			inline object_prototype* prototype() const { return m_prototype; }
+			inline u32 count() const { return u32(m_names.size()); }
+			inline atom_id name(u32 idx) const { return m_names[idx]; }
+
+		protected:
+			object_shape(const object_shape* parent, atom_id name);
+
+			object_prototype* m_prototype;
+			object_shape* m_root;
+			bool m_dictionary;
+
+			// property names in slot order
+			std::vector<atom_id> m_names;
+			munordered_map<atom_id, u32> m_indices;
+			munordered_map<atom_id, object_shape*> m_transitions;
+	};
+
+	// remembers the results of a prop or propAssign instruction for up to
+	// max_entries shapes
+	struct property_cache {
+		enum entry_kind {
+			// slot is the index of the object's property
+			ek_slot = 0,
+			// value is the id of a prototype method
+			ek_method,
+			// propAssign adding a property, transition is the object's new shape and
+			// slot is the index of the new property
+			ek_transition
+		};
+
+		struct entry {
+			object_shape* shape;
+			object_shape* transition;
+			variable_id value;
+			u32 slot;
+			u8 kind;
+		};
+
+		static const u8 max_entries = 4;
+		// the property that the instruction accesses
+		atom_id name;
+		entry entries[max_entries];
+		u8 count;
+		// entry that's replaced next when the cache is full
+		u8 next;
+	};
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <trace.h>
+using namespace std;
+
+namespace rs {
+	const char* instruction_name(rs_instruction code) {
+		static const char* istr[] = {
+			"null",
+			"store",
+			"newObj",
+			"addProto",
+			"prop",
+			"propAssign",
+			"move",
+			"add",
+			"sub",
+			"mul",
+			"div",
+			"mod",
+			"pow",
+			"or",
+			"and",
+			"less",
+			"greater",
+			"addEq",
+			"subEq",
+			"mulEq",
+			"divEq",
+			"modEq",
+			"powEq",
+			"orEq",
+			"andEq",
+			"lessEq",
+			"greaterEq",
+			"compare",
+			"inc",
+			"dec",
+			"branch",
+			"clearParams",
+			"call",
+			"jump",
+			"ret",
+			"pushState",
+			"popState",
+			"pushScope",
+			"popScope"
+		};
+
+		if (code >= rs_instruction::instruction_count) return "unknown";
+		return istr[code];
+	}
+
+	const char* register_name(rs_register reg) {
+		static const char* rstr[] = {
+			"null",
+			"this_obj",
+			"return_val",
+			"lvalue",
+			"rvalue",
+			"parameter0",
+			"parameter1",
+			"parameter2",
+			"parameter3",
+			"parameter4",
+			"parameter5",
+			"parameter6",
+			"parameter7",
+			"parameter_count",
+			"scratch0",
+			"scratch1",
+			"scratch2",
+			"scratch3",
+			"scratch4",
+			"scratch5",
+			"scratch6",
+			"scratch7"
+		};
+
+		if (reg >= rs_register::register_count) return "unknown";
+		return rstr[reg];
+	}
+
+
+
+	callback_trace_sink::callback_trace_sink(trace_callback cb, void* userdata) {
+		m_callback = cb;
+		m_userdata = userdata;
+	}
+
+	void callback_trace_sink::write(const string& line) {
+		if (m_callback) m_callback(line, m_userdata);
+	}
+
+
+
+	ring_buffer_trace_sink::ring_buffer_trace_sink(size_t capacity) {
+		m_capacity = capacity > 0 ? capacity : 1;
+		m_lines.resize(m_capacity);
+		m_next = 0;
+		m_count = 0;
+	}
+
+	void ring_buffer_trace_sink::write(const string& line) {
+		m_lines[m_next] = line;
+		m_next = (m_next + 1) % m_capacity;
+		if (m_count < m_capacity) m_count++;
+	}
+
+	vector<string> ring_buffer_trace_sink::lines() const {
+		vector<string> out;
+		size_t first = (m_next + m_capacity - m_count) % m_capacity;
+		for (size_t i = 0;i < m_count;i++) out.push_back(m_lines[(first + i) % m_capacity]);
+		return out;
+	}
+
+	void ring_buffer_trace_sink::clear() {
+		m_next = 0;
+		m_count = 0;
+	}
+
+
+
+	file_trace_sink::file_trace_sink(FILE* fp) {
+		m_fp = fp;
+		m_owns_file = false;
+	}
+
+	file_trace_sink::file_trace_sink(const string& path) {
+		m_fp = fopen(path.c_str(), "w");
+		m_owns_file = true;
+	}
+
+	file_trace_sink::~file_trace_sink() {
+		if (m_fp && m_owns_file) fclose(m_fp);
+		m_fp = nullptr;
+	}
+
+	void file_trace_sink::write(const string& line) {
+		if (!m_fp) return;
+		fwrite(line.c_str(), 1, line.length(), m_fp);
+		fputc('\n', m_fp);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <defs.h>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace rs {
+	const char* instruction_name(rs_instruction code);
+	const char* register_name(rs_register reg);
+
+	class trace_sink {
+		public:
+			virtual ~trace_sink() { }
+			virtual void write(const std::string& line) = 0;
+	};
+
+	typedef void (*trace_callback)(const std::string& line, void* userdata);
+
+	class callback_trace_sink : public trace_sink {
+		public:
+			callback_trace_sink(trace_callback cb, void* userdata = nullptr);
+			~callback_trace_sink() { }
+
+			virtual void write(const std::string& line);
+
+		protected:
+			trace_callback m_callback;
+			void* m_userdata;
+	};
+
+	// keeps only the most recent lines, useful for dumping the
+	// instructions that led up to a runtime exception
+	class ring_buffer_trace_sink : public trace_sink {
+		public:
+			ring_buffer_trace_sink(size_t capacity);
+			~ring_buffer_trace_sink() { }
+
+			virtual void write(const std::string& line);
+			std::vector<std::string> lines() const;
+			void clear();
+
+		protected:
+			std::vector<std::string> m_lines;
+			size_t m_capacity;
+			size_t m_next;
+			size_t m_count;
+	};
+
+	class file_trace_sink : public trace_sink {
+		public:
+			// does not take ownership of fp
+			file_trace_sink(FILE* fp);
+			file_trace_sink(const std::string& path);
+			~file_trace_sink();
+
+			virtual void write(const std::string& line);
+			inline bool is_open() const { return m_fp != nullptr; }
+
+		protected:
+			FILE* m_fp;
+			bool m_owns_file;
+	};
+};
\ No newline at end of file